@@ -0,0 +1,354 @@
+/** @file
+FfaBenchmarkResults.c
+
+Persists benchmark results of the test application as JSON and checks them
+against a baseline from a previous build.
+
+The results file has the following layout, with one object per metric:
+
+  {
+    "BuildId": "<PcdFfaBenchmarkBuildId>",
+    "Metrics": [
+      { "Name": "...", "Units": "ns", "Samples": 64, "Min": 0, "P50": 0, "P90": 0, "P99": 0, "Max": 0, "Mean": 0 }
+    ]
+  }
+
+A results file from a known good build can be copied to the baseline file name
+to gate later builds on it.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Protocol/LoadedImage.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/FileHandleLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "FfaPartitionTestApp.h"
+
+// Upper bound of the serialized size of a single metric object
+#define FFA_BENCH_JSON_METRIC_SIZE  (FFA_BENCH_NAME_LENGTH + FFA_BENCH_UNITS_LENGTH + 256)
+#define FFA_BENCH_JSON_HEADER_SIZE  256
+
+/**
+  Opens a file in the root of the file system the application was loaded from.
+
+  @param[in]  FileName  Name of the file to open.
+  @param[in]  OpenMode  EFI_FILE_MODE_* flags to open the file with.
+  @param[out] File      The opened file handle.
+
+  @retval EFI_SUCCESS  The file was opened.
+  @retval Others       The file system or file could not be opened.
+**/
+STATIC
+EFI_STATUS
+OpenBenchmarkFile (
+  IN  CONST CHAR16       *FileName,
+  IN  UINT64             OpenMode,
+  OUT EFI_FILE_PROTOCOL  **File
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_LOADED_IMAGE_PROTOCOL        *LoadedImage;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *FileSystem;
+  EFI_FILE_PROTOCOL                *Root;
+
+  Status = gBS->HandleProtocol (gImageHandle, &gEfiLoadedImageProtocolGuid, (VOID **)&LoadedImage);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (LoadedImage->DeviceHandle, &gEfiSimpleFileSystemProtocolGuid, (VOID **)&FileSystem);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = FileSystem->OpenVolume (FileSystem, &Root);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Root->Open (Root, File, (CHAR16 *)FileName, OpenMode, 0);
+  Root->Close (Root);
+  return Status;
+}
+
+/**
+  Finds the value of a numeric field inside the metric object of a baseline file.
+
+  Only the braces enclosing the "Name" field bound the search, so fields of the
+  neighbouring metric objects are never picked up.
+
+  @param[in]  Baseline  Start of the baseline file.
+  @param[in]  Metric    The "Name" field of the metric object.
+  @param[in]  Field     Field name including the quotes, e.g. "\"P50\"".
+  @param[out] Value     Parsed value of the field.
+
+  @retval TRUE   The field was found in the metric object and holds a number.
+  @retval FALSE  The field is missing, not a number or the object is malformed.
+**/
+STATIC
+BOOLEAN
+FindMetricField (
+  IN  CONST CHAR8  *Baseline,
+  IN  CONST CHAR8  *Metric,
+  IN  CONST CHAR8  *Field,
+  OUT UINT64       *Value
+  )
+{
+  CONST CHAR8  *Start;
+  CONST CHAR8  *End;
+  CONST CHAR8  *Match;
+  UINTN        FieldLength;
+
+  for (Start = Metric; (Start > Baseline) && (*Start != '{'); Start--) {
+  }
+
+  End = AsciiStrStr (Metric, "}");
+  if ((*Start != '{') || (End == NULL)) {
+    return FALSE;
+  }
+
+  FieldLength = AsciiStrLen (Field);
+  for (Match = Start; Match + FieldLength <= End; Match++) {
+    if (AsciiStrnCmp (Match, Field, FieldLength) == 0) {
+      break;
+    }
+  }
+
+  if (Match + FieldLength > End) {
+    return FALSE;
+  }
+
+  Match += FieldLength;
+  while ((*Match == ' ') || (*Match == ':')) {
+    Match++;
+  }
+
+  if ((*Match < '0') || (*Match > '9')) {
+    return FALSE;
+  }
+
+  *Value = AsciiStrDecimalToUint64 (Match);
+  return TRUE;
+}
+
+/**
+  Checks whether a latency exceeds its baseline by more than the threshold.
+
+  @param[in] Current    Latency measured by this run.
+  @param[in] Baseline   Latency recorded in the baseline.
+  @param[in] Threshold  Allowed increase in percent.
+
+  @retval TRUE   The latency regressed.
+  @retval FALSE  The latency is within the threshold.
+**/
+STATIC
+BOOLEAN
+IsRegression (
+  IN UINT64  Current,
+  IN UINT64  Baseline,
+  IN UINT32  Threshold
+  )
+{
+  return MultU64x32 (Current, 100) > MultU64x32 (Baseline, 100 + Threshold);
+}
+
+/**
+  This routine writes all recorded benchmark results as JSON to the file system
+  the application was loaded from.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfSaveResults (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS         Status;
+  EFI_FILE_PROTOCOL  *File;
+  CONST CHAR16       *FileName;
+  CHAR8              *Json;
+  UINTN              JsonSize;
+  UINTN              Length;
+  UINTN              Index;
+  FFA_BENCH_RESULT   *Result;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  if (gFfaBenchResultCount == 0) {
+    UT_LOG_WARNING ("No benchmark results recorded, nothing to save.");
+    return UNIT_TEST_PASSED;
+  }
+
+  JsonSize = FFA_BENCH_JSON_HEADER_SIZE + (gFfaBenchResultCount * FFA_BENCH_JSON_METRIC_SIZE);
+  Json     = AllocateZeroPool (JsonSize);
+  UT_ASSERT_NOT_NULL (Json);
+
+  Length = AsciiSPrint (
+             Json,
+             JsonSize,
+             "{\n  \"BuildId\": \"%a\",\n  \"Metrics\": [\n",
+             (CONST CHAR8 *)FixedPcdGetPtr (PcdFfaBenchmarkBuildId)
+             );
+
+  for (Index = 0; Index < gFfaBenchResultCount; Index++) {
+    Result  = &gFfaBenchResults[Index];
+    Length += AsciiSPrint (
+                Json + Length,
+                JsonSize - Length,
+                "    { \"Name\": \"%a\", \"Units\": \"%a\", \"Samples\": %u, \"Min\": %lu, \"P50\": %lu, "
+                "\"P90\": %lu, \"P99\": %lu, \"Max\": %lu, \"Mean\": %lu }%a\n",
+                Result->Name,
+                Result->Units,
+                (UINT32)Result->SampleCount,
+                Result->Min,
+                Result->P50,
+                Result->P90,
+                Result->P99,
+                Result->Max,
+                Result->Mean,
+                (Index + 1 < gFfaBenchResultCount) ? "," : ""
+                );
+  }
+
+  Length += AsciiSPrint (Json + Length, JsonSize - Length, "  ]\n}\n");
+
+  // Replace any results left over from a previous run
+  FileName = (CONST CHAR16 *)FixedPcdGetPtr (PcdFfaBenchmarkResultsFile);
+  Status   = OpenBenchmarkFile (FileName, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+  if (!EFI_ERROR (Status)) {
+    FileHandleDelete (File);
+  }
+
+  Status = OpenBenchmarkFile (FileName, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Unable to create %s (%r).\n", __func__, FileName, Status));
+    FreePool (Json);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  Status = FileHandleWrite (File, &Length, Json);
+  FileHandleClose (File);
+  FreePool (Json);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Unable to write %s (%r).\n", __func__, FileName, Status));
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  UT_LOG_INFO ("Saved %u benchmark results to %s", (UINT32)gFfaBenchResultCount, FileName);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  This routine compares the recorded benchmark results against a baseline file
+  and fails if any metric regressed beyond the configured threshold.
+
+  Metrics missing from the baseline are reported but not treated as failures.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfCheckBaseline (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS         Status;
+  EFI_FILE_PROTOCOL  *File;
+  CONST CHAR16       *FileName;
+  CHAR8              *Baseline;
+  UINT64             FileSize;
+  UINTN              ReadSize;
+  UINTN              Index;
+  UINTN              Regressions;
+  UINTN              Missing;
+  UINT32             Threshold;
+  CHAR8              Key[FFA_BENCH_NAME_LENGTH + 16];
+  CONST CHAR8        *Metric;
+  UINT64             BaseP50;
+  UINT64             BaseP99;
+  FFA_BENCH_RESULT   *Result;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  FileName = (CONST CHAR16 *)FixedPcdGetPtr (PcdFfaBenchmarkBaselineFile);
+  Status   = OpenBenchmarkFile (FileName, EFI_FILE_MODE_READ, &File);
+  if (EFI_ERROR (Status)) {
+    UT_LOG_WARNING ("Baseline %s not found (%r), skipping regression check.", FileName, Status);
+    return UNIT_TEST_PASSED;
+  }
+
+  Status = FileHandleGetSize (File, &FileSize);
+  if (EFI_ERROR (Status) || (FileSize == 0) || (FileSize >= MAX_UINTN)) {
+    FileHandleClose (File);
+    UT_LOG_ERROR ("Baseline %s has an invalid size (%r).", FileName, Status);
+    return UNIT_TEST_ERROR_TEST_FAILED;
+  }
+
+  ReadSize = (UINTN)FileSize;
+  Baseline = AllocateZeroPool (ReadSize + 1);
+  if (Baseline == NULL) {
+    FileHandleClose (File);
+    UT_ASSERT_NOT_NULL (Baseline);
+  }
+
+  Status = FileHandleRead (File, &ReadSize, Baseline);
+  FileHandleClose (File);
+  if (EFI_ERROR (Status)) {
+    FreePool (Baseline);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  Threshold   = FixedPcdGet32 (PcdFfaBenchmarkRegressionThreshold);
+  Regressions = 0;
+  Missing     = 0;
+  for (Index = 0; Index < gFfaBenchResultCount; Index++) {
+    Result = &gFfaBenchResults[Index];
+    AsciiSPrint (Key, sizeof (Key), "\"Name\": \"%a\"", Result->Name);
+    Metric = AsciiStrStr (Baseline, Key);
+    if ((Metric == NULL) ||
+        !FindMetricField (Baseline, Metric, "\"P50\"", &BaseP50) ||
+        !FindMetricField (Baseline, Metric, "\"P99\"", &BaseP99))
+    {
+      // A renamed metric or a reformatted baseline must not turn the gate off
+      DEBUG ((DEBUG_ERROR, "%a: %a missing or unparsable in baseline %s\n", __func__, Result->Name, FileName));
+      UT_LOG_ERROR ("%a: missing or unparsable in baseline.", Result->Name);
+      Missing++;
+      continue;
+    }
+
+    if (IsRegression (Result->P50, BaseP50, Threshold) ||
+        IsRegression (Result->P99, BaseP99, Threshold))
+    {
+      DEBUG ((
+        DEBUG_ERROR,
+        "%a: %a regressed, p50 %lu -> %lu, p99 %lu -> %lu %a (threshold %d%%)\n",
+        __func__,
+        Result->Name,
+        BaseP50,
+        Result->P50,
+        BaseP99,
+        Result->P99,
+        Result->Units,
+        Threshold
+        ));
+      UT_LOG_ERROR ("%a: regressed, p50 %lu -> %lu, p99 %lu -> %lu", Result->Name, BaseP50, Result->P50, BaseP99, Result->P99);
+      Regressions++;
+    }
+  }
+
+  FreePool (Baseline);
+
+  UT_ASSERT_EQUAL (Missing, 0);
+  UT_ASSERT_EQUAL (Regressions, 0);
+  return UNIT_TEST_PASSED;
+}
@@ -0,0 +1,379 @@
+/** @file
+FfaPartitionBenchmark.c
+
+Latency benchmarks for FF-A interfaces used by the test application.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Protocol/MmCommunication2.h>
+#include <Guid/NotificationServiceFfa.h>
+#include <Guid/TestServiceFfa.h>
+#include <Guid/Tpm2ServiceFfa.h>
+#include <Guid/ZeroGuid.h>
+
+#include <Library/ArmFfaLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "FfaPartitionTestApp.h"
+
+#define FFA_BENCH_ITERATIONS        64
+#define FFA_BENCH_MAX_PARTITIONS    64
+
+// Number of partition descriptors that fit in x3-x17 of FFA_PARTITION_INFO_GET_REGS
+#define FFA_BENCH_REGS_DESC_MAX  ((15 * sizeof (UINT64)) / sizeof (EFI_FFA_PART_INFO_DESC))
+
+// Times a FFA_PARTITION_INFO_GET_REGS sweep starts over after its tag went stale
+#define FFA_BENCH_REGS_RETRIES  3
+
+STATIC UINT64  mSamples[FFA_BENCH_ITERATIONS];
+
+FFA_BENCH_RESULT  gFfaBenchResults[FFA_BENCH_MAX_RESULTS];
+UINTN             gFfaBenchResultCount;
+
+// Number of UUID lookups performed back to back for each discovery measurement
+STATIC CONST UINTN  mDiscoveryLookupCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+/**
+  Reads the current time in nanoseconds from the platform performance counter.
+
+  @retval The current time in nanoseconds.
+**/
+UINT64
+FfaBenchmarkGetTimeNs (
+  VOID
+  )
+{
+  return GetTimeInNanoSecond (GetPerformanceCounter ());
+}
+
+/**
+  Sorts latency samples in ascending order.
+
+  @param[in, out] Samples      Array of latency samples.
+  @param[in]      SampleCount  Number of entries in Samples.
+**/
+VOID
+FfaBenchmarkSortSamples (
+  IN OUT UINT64  *Samples,
+  IN     UINTN   SampleCount
+  )
+{
+  UINTN   Index;
+  UINTN   Insert;
+  UINT64  Value;
+
+  for (Index = 1; Index < SampleCount; Index++) {
+    Value  = Samples[Index];
+    Insert = Index;
+    while ((Insert > 0) && (Samples[Insert - 1] > Value)) {
+      Samples[Insert] = Samples[Insert - 1];
+      Insert--;
+    }
+
+    Samples[Insert] = Value;
+  }
+}
+
+/**
+  Returns the nearest-rank percentile of a sorted sample set.
+
+  @param[in] Sorted       Array of samples in ascending order.
+  @param[in] SampleCount  Number of entries in Sorted, must be non-zero.
+  @param[in] Percent      Percentile to compute, 0 - 100.
+
+  @retval The sample at the requested percentile.
+**/
+UINT64
+FfaBenchmarkPercentile (
+  IN CONST UINT64  *Sorted,
+  IN UINTN         SampleCount,
+  IN UINTN         Percent
+  )
+{
+  UINTN  Rank;
+
+  Rank = ((SampleCount * Percent) + 99) / 100;
+  if (Rank == 0) {
+    Rank = 1;
+  }
+
+  return Sorted[Rank - 1];
+}
+
+/**
+  Reports the latency distribution of a benchmark metric.
+
+  The samples are sorted in place and the summary is recorded in the result
+  table so it can be persisted after the suite completes.
+
+  @param[in]      Name         Name of the metric.
+  @param[in, out] Samples      Array of latency samples in nanoseconds.
+  @param[in]      SampleCount  Number of entries in Samples.
+**/
+VOID
+FfaBenchmarkReport (
+  IN     CONST CHAR8  *Name,
+  IN OUT UINT64       *Samples,
+  IN     UINTN        SampleCount
+  )
+{
+  UINTN             Index;
+  UINT64            Total;
+  FFA_BENCH_RESULT  Result;
+
+  if ((Samples == NULL) || (SampleCount == 0)) {
+    return;
+  }
+
+  FfaBenchmarkSortSamples (Samples, SampleCount);
+
+  Total = 0;
+  for (Index = 0; Index < SampleCount; Index++) {
+    Total += Samples[Index];
+  }
+
+  ZeroMem (&Result, sizeof (Result));
+  AsciiStrCpyS (Result.Name, sizeof (Result.Name), Name);
+  AsciiStrCpyS (Result.Units, sizeof (Result.Units), "ns");
+  Result.SampleCount = SampleCount;
+  Result.Min         = Samples[0];
+  Result.P50         = FfaBenchmarkPercentile (Samples, SampleCount, 50);
+  Result.P90         = FfaBenchmarkPercentile (Samples, SampleCount, 90);
+  Result.P99         = FfaBenchmarkPercentile (Samples, SampleCount, 99);
+  Result.Max         = Samples[SampleCount - 1];
+  Result.Mean        = DivU64x32 (Total, (UINT32)SampleCount);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: %a min=%lu p50=%lu p90=%lu p99=%lu max=%lu mean=%lu %a (%u samples)\n",
+    __func__,
+    Result.Name,
+    Result.Min,
+    Result.P50,
+    Result.P90,
+    Result.P99,
+    Result.Max,
+    Result.Mean,
+    Result.Units,
+    (UINT32)Result.SampleCount
+    ));
+  UT_LOG_INFO ("%a: p50=%lu p99=%lu %a", Result.Name, Result.P50, Result.P99, Result.Units);
+
+  // Re-running a metric replaces its previous entry
+  for (Index = 0; Index < gFfaBenchResultCount; Index++) {
+    if (AsciiStrCmp (gFfaBenchResults[Index].Name, Result.Name) == 0) {
+      break;
+    }
+  }
+
+  if (Index == FFA_BENCH_MAX_RESULTS) {
+    DEBUG ((DEBUG_WARN, "%a: result table full, %a not recorded\n", __func__, Result.Name));
+    return;
+  }
+
+  CopyMem (&gFfaBenchResults[Index], &Result, sizeof (Result));
+  if (Index == gFfaBenchResultCount) {
+    gFfaBenchResultCount++;
+  }
+}
+
+/**
+  Looks up the partitions hosting a service through FFA_PARTITION_INFO_GET_REGS.
+
+  A NULL or zero GUID queries all partitions, which may take several calls when
+  the partition count exceeds what fits in the return registers. The sweep
+  continues until the last index reported by the SPMC was returned and starts
+  over when the UUID information tag goes stale.
+
+  @param[in]  ServiceGuid  Service to look up.
+  @param[out] PartCount    Number of partitions found.
+
+  @retval EFI_SUCCESS  Every partition was returned.
+  @retval Others       A query failed.
+**/
+STATIC
+EFI_STATUS
+DiscoverViaRegs (
+  IN  EFI_GUID  *ServiceGuid,
+  OUT UINT32    *PartCount
+  )
+{
+  EFI_STATUS              Status;
+  EFI_FFA_PART_INFO_DESC  PartDesc[FFA_BENCH_REGS_DESC_MAX];
+  UINT32                  Count;
+  UINT16                  StartIndex;
+  UINT16                  LastIndex;
+  UINT16                  Tag;
+  UINTN                   Retries;
+
+  *PartCount = 0;
+  StartIndex = 0;
+  Tag        = 0;
+  Retries    = 0;
+
+  while (*PartCount < FFA_BENCH_MAX_PARTITIONS) {
+    Count  = ARRAY_SIZE (PartDesc);
+    Status = FfaPartitionInfoGetRegsEx (ServiceGuid, StartIndex, &Tag, &LastIndex, &Count, PartDesc);
+    if ((Status == EFI_NOT_READY) && (StartIndex != 0) && (Retries < FFA_BENCH_REGS_RETRIES)) {
+      // The partition information changed during the sweep, start it over
+      Retries++;
+      *PartCount = 0;
+      StartIndex = 0;
+      Tag        = 0;
+      continue;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    *PartCount += Count;
+    StartIndex += (UINT16)Count;
+    if (StartIndex > LastIndex) {
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Looks up the partitions hosting a service through FFA_PARTITION_INFO_GET and
+  releases the RX buffer afterwards.
+
+  @param[in]  ServiceGuid  Service to look up.
+  @param[out] PartCount    Number of partitions found.
+
+  @retval EFI_SUCCESS  The lookup succeeded and the RX buffer was released.
+  @retval Others       The lookup or the RX buffer release failed.
+**/
+STATIC
+EFI_STATUS
+DiscoverViaRxBuffer (
+  IN  EFI_GUID  *ServiceGuid,
+  OUT UINT32    *PartCount
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Size;
+
+  *PartCount = 0;
+  Status     = ArmFfaLibPartitionInfoGet (ServiceGuid, 0, PartCount, &Size);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return ArmFfaLibRxRelease (0);
+}
+
+/**
+  This routine benchmarks partition discovery through FFA_PARTITION_INFO_GET_REGS
+  against FFA_PARTITION_INFO_GET through the RX buffer.
+
+  For each method, 1 to N service UUIDs are looked up back to back and the latency
+  per lookup is reported, followed by the null UUID query for all partitions.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfPartitionDiscovery (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  EFI_GUID    *PresentGuids[4];
+  UINTN       PresentCount;
+  UINTN       Index;
+  UINTN       Iteration;
+  UINTN       Lookup;
+  UINTN       LookupCount;
+  UINT32      PartCount;
+  UINT64      Start;
+  CHAR8       Name[FFA_BENCH_NAME_LENGTH];
+  EFI_GUID    *GuidsOfInterest[] = {
+    &gEfiMmCommunication2ProtocolGuid,
+    &gEfiTestServiceFfaGuid,
+    &gTpm2ServiceFfaGuid,
+    &gEfiNotificationServiceFfaGuid,
+  };
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  // Only benchmark lookups that succeed, a miss takes a different path in the SPMC
+  PresentCount = 0;
+  for (Index = 0; Index < ARRAY_SIZE (GuidsOfInterest); Index++) {
+    Status = DiscoverViaRegs (GuidsOfInterest[Index], &PartCount);
+    if (!EFI_ERROR (Status)) {
+      PresentGuids[PresentCount++] = GuidsOfInterest[Index];
+    }
+  }
+
+  UT_ASSERT_NOT_EQUAL (PresentCount, 0);
+
+  for (Index = 0; Index < ARRAY_SIZE (mDiscoveryLookupCounts); Index++) {
+    LookupCount = mDiscoveryLookupCounts[Index];
+
+    for (Iteration = 0; Iteration < FFA_BENCH_ITERATIONS; Iteration++) {
+      Start = FfaBenchmarkGetTimeNs ();
+      for (Lookup = 0; Lookup < LookupCount; Lookup++) {
+        Status = DiscoverViaRegs (PresentGuids[Lookup % PresentCount], &PartCount);
+        UT_ASSERT_NOT_EFI_ERROR (Status);
+      }
+
+      mSamples[Iteration] = DivU64x32 (FfaBenchmarkGetTimeNs () - Start, (UINT32)LookupCount);
+    }
+
+    AsciiSPrint (Name, sizeof (Name), "Discovery.Regs.Uuids%u", (UINT32)LookupCount);
+    FfaBenchmarkReport (Name, mSamples, FFA_BENCH_ITERATIONS);
+
+    for (Iteration = 0; Iteration < FFA_BENCH_ITERATIONS; Iteration++) {
+      Start = FfaBenchmarkGetTimeNs ();
+      for (Lookup = 0; Lookup < LookupCount; Lookup++) {
+        Status = DiscoverViaRxBuffer (PresentGuids[Lookup % PresentCount], &PartCount);
+        UT_ASSERT_NOT_EFI_ERROR (Status);
+      }
+
+      mSamples[Iteration] = DivU64x32 (FfaBenchmarkGetTimeNs () - Start, (UINT32)LookupCount);
+    }
+
+    AsciiSPrint (Name, sizeof (Name), "Discovery.RxBuffer.Uuids%u", (UINT32)LookupCount);
+    FfaBenchmarkReport (Name, mSamples, FFA_BENCH_ITERATIONS);
+  }
+
+  //
+  // The null UUID returns every partition in the system, compare one full sweep
+  // through the registers against a single RX buffer query.
+  //
+  for (Iteration = 0; Iteration < FFA_BENCH_ITERATIONS; Iteration++) {
+    Start  = FfaBenchmarkGetTimeNs ();
+    Status = DiscoverViaRegs (&gZeroGuid, &PartCount);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    mSamples[Iteration] = FfaBenchmarkGetTimeNs () - Start;
+  }
+
+  DEBUG ((DEBUG_INFO, "%a: null UUID via registers found %d partitions\n", __func__, PartCount));
+  FfaBenchmarkReport ("Discovery.Regs.NullUuid", mSamples, FFA_BENCH_ITERATIONS);
+
+  for (Iteration = 0; Iteration < FFA_BENCH_ITERATIONS; Iteration++) {
+    Start  = FfaBenchmarkGetTimeNs ();
+    Status = DiscoverViaRxBuffer (&gZeroGuid, &PartCount);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    mSamples[Iteration] = FfaBenchmarkGetTimeNs () - Start;
+  }
+
+  DEBUG ((DEBUG_INFO, "%a: null UUID via RX buffer found %d partitions\n", __func__, PartCount));
+  FfaBenchmarkReport ("Discovery.RxBuffer.NullUuid", mSamples, FFA_BENCH_ITERATIONS);
+
+  return UNIT_TEST_PASSED;
+}
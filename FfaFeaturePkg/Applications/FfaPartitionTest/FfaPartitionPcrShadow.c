@@ -0,0 +1,392 @@
+/** @file
+FfaPartitionPcrShadow.c
+
+Coherency test of the PCR shadow of the TPM service.
+
+Raw TPM2_PCR_Read, TPM2_PCR_Extend and TPM2_PCR_Reset commands are sent on
+the debug PCR through the TCG2 protocol. Repeated reads must return identical
+responses, reads after an extend must return the new value and reads after a
+reset must return the reset value, whether they are answered by the TPM or by
+the PCR shadow. When PcdTpmServicePcrShadow is set and the TPM service shares
+its partition with the test service, the shadow counters are checked as well:
+repeated reads must hit, extends must invalidate, resets must resync and the
+reads following either must miss.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/Tpm20.h>
+#include <Guid/TestServiceFfa.h>
+#include <Protocol/Tcg2Protocol.h>
+
+#include <Library/ArmFfaLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "FfaPartitionTestApp.h"
+
+// Debug PCR, resettable from any locality
+#define PCR_SHADOW_TEST_PCR  16
+
+#define PCR_SHADOW_TEST_BUFFER_SIZE  256
+
+// Offset of the single SHA256 digest in a TPM2_PCR_Read response selecting one PCR
+#define PCR_READ_SELECTION_SIZE  (sizeof (UINT32) + sizeof (TPMI_ALG_HASH) + sizeof (UINT8) + PCR_SELECT_MIN)
+#define PCR_READ_DIGEST_OFFSET   (sizeof (TPM2_RESPONSE_HEADER) + sizeof (UINT32) + PCR_READ_SELECTION_SIZE + sizeof (UINT32) + sizeof (UINT16))
+
+// PCR shadow counters reported by the test service telemetry
+typedef struct {
+  UINT64    Hits;
+  UINT64    Misses;
+  UINT64    Resyncs;
+  UINT64    Invalidations;
+} PCR_SHADOW_TEST_COUNTERS;
+
+/**
+  Appends a big endian UINT16 to a TPM command.
+
+  @param[in, out] Cursor  Write position, advanced past the value.
+  @param[in]      Value   Value to append.
+**/
+STATIC
+VOID
+PutBe16 (
+  IN OUT UINT8   **Cursor,
+  IN     UINT16  Value
+  )
+{
+  WriteUnaligned16 ((UINT16 *)*Cursor, SwapBytes16 (Value));
+  *Cursor += sizeof (UINT16);
+}
+
+/**
+  Appends a big endian UINT32 to a TPM command.
+
+  @param[in, out] Cursor  Write position, advanced past the value.
+  @param[in]      Value   Value to append.
+**/
+STATIC
+VOID
+PutBe32 (
+  IN OUT UINT8   **Cursor,
+  IN     UINT32  Value
+  )
+{
+  WriteUnaligned32 ((UINT32 *)*Cursor, SwapBytes32 (Value));
+  *Cursor += sizeof (UINT32);
+}
+
+/**
+  Appends an empty password session authorizing the PCR handle of a command.
+
+  @param[in, out] Cursor  Write position, advanced past the session.
+**/
+STATIC
+VOID
+PutPasswordSession (
+  IN OUT UINT8  **Cursor
+  )
+{
+  PutBe32 (Cursor, sizeof (UINT32) + sizeof (UINT16) + sizeof (UINT8) + sizeof (UINT16));
+  PutBe32 (Cursor, TPM_RS_PW);
+  PutBe16 (Cursor, 0);
+  **Cursor = 0;
+  *Cursor += sizeof (UINT8);
+  PutBe16 (Cursor, 0);
+}
+
+/**
+  Sends a command through the TCG2 protocol and checks its response code.
+
+  @param[in]  Tcg2          TCG2 protocol instance.
+  @param[in]  Command       Command to send.
+  @param[in]  CommandEnd    End of the command, the header size is patched in.
+  @param[out] Response      Receives the response.
+  @param[out] ResponseSize  Receives the size of the response.
+
+  @retval EFI_SUCCESS       The TPM returned TPM_RC_SUCCESS.
+  @retval EFI_DEVICE_ERROR  The TPM returned an error.
+  @retval Others            The command could not be submitted.
+**/
+STATIC
+EFI_STATUS
+PcrShadowSubmit (
+  IN  EFI_TCG2_PROTOCOL  *Tcg2,
+  IN  UINT8              *Command,
+  IN  UINT8              *CommandEnd,
+  OUT UINT8              *Response,
+  OUT UINT32             *ResponseSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      CommandSize;
+  UINT32      ResponseCode;
+
+  CommandSize = (UINT32)(CommandEnd - Command);
+  WriteUnaligned32 ((UINT32 *)(Command + OFFSET_OF (TPM2_COMMAND_HEADER, paramSize)), SwapBytes32 (CommandSize));
+
+  ZeroMem (Response, PCR_SHADOW_TEST_BUFFER_SIZE);
+  Status = Tcg2->SubmitCommand (Tcg2, CommandSize, Command, PCR_SHADOW_TEST_BUFFER_SIZE, Response);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *ResponseSize = SwapBytes32 (ReadUnaligned32 ((UINT32 *)(Response + OFFSET_OF (TPM2_RESPONSE_HEADER, paramSize))));
+  ResponseCode  = SwapBytes32 (ReadUnaligned32 ((UINT32 *)(Response + OFFSET_OF (TPM2_RESPONSE_HEADER, responseCode))));
+  if ((ResponseCode != TPM_RC_SUCCESS) || (*ResponseSize > PCR_SHADOW_TEST_BUFFER_SIZE)) {
+    DEBUG ((DEBUG_ERROR, "%a: TPM response code %x\n", __func__, ResponseCode));
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads the SHA256 bank of the test PCR.
+
+  @param[in]  Tcg2          TCG2 protocol instance.
+  @param[out] Response      Receives the TPM2_PCR_Read response.
+  @param[out] ResponseSize  Receives the size of the response.
+
+  @retval EFI_SUCCESS  The PCR was read and the response holds a single SHA256 digest.
+  @retval Others       The read failed.
+**/
+STATIC
+EFI_STATUS
+PcrShadowRead (
+  IN  EFI_TCG2_PROTOCOL  *Tcg2,
+  OUT UINT8              *Response,
+  OUT UINT32             *ResponseSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Command[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT8       *Cursor;
+
+  Cursor = Command;
+  PutBe16 (&Cursor, TPM_ST_NO_SESSIONS);
+  PutBe32 (&Cursor, 0);
+  PutBe32 (&Cursor, TPM_CC_PCR_Read);
+  PutBe32 (&Cursor, 1);
+  PutBe16 (&Cursor, TPM_ALG_SHA256);
+  *Cursor++ = PCR_SELECT_MIN;
+  ZeroMem (Cursor, PCR_SELECT_MIN);
+  Cursor[PCR_SHADOW_TEST_PCR / 8] = (UINT8)(1 << (PCR_SHADOW_TEST_PCR % 8));
+  Cursor                         += PCR_SELECT_MIN;
+
+  Status = PcrShadowSubmit (Tcg2, Command, Cursor, Response, ResponseSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (*ResponseSize != PCR_READ_DIGEST_OFFSET + SHA256_DIGEST_SIZE) {
+    DEBUG ((DEBUG_ERROR, "%a: Unexpected response size %d\n", __func__, *ResponseSize));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Extends the SHA256 bank of the test PCR.
+
+  @param[in] Tcg2  TCG2 protocol instance.
+
+  @retval EFI_SUCCESS  The PCR was extended.
+  @retval Others       The extend failed.
+**/
+STATIC
+EFI_STATUS
+PcrShadowExtend (
+  IN EFI_TCG2_PROTOCOL  *Tcg2
+  )
+{
+  UINT8   Command[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT8   Response[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT32  ResponseSize;
+  UINT8   *Cursor;
+
+  Cursor = Command;
+  PutBe16 (&Cursor, TPM_ST_SESSIONS);
+  PutBe32 (&Cursor, 0);
+  PutBe32 (&Cursor, TPM_CC_PCR_Extend);
+  PutBe32 (&Cursor, PCR_SHADOW_TEST_PCR);
+  PutPasswordSession (&Cursor);
+  PutBe32 (&Cursor, 1);
+  PutBe16 (&Cursor, TPM_ALG_SHA256);
+  SetMem (Cursor, SHA256_DIGEST_SIZE, 0xA5);
+  Cursor += SHA256_DIGEST_SIZE;
+
+  return PcrShadowSubmit (Tcg2, Command, Cursor, Response, &ResponseSize);
+}
+
+/**
+  Resets the test PCR.
+
+  @param[in] Tcg2  TCG2 protocol instance.
+
+  @retval EFI_SUCCESS  The PCR was reset.
+  @retval Others       The reset failed.
+**/
+STATIC
+EFI_STATUS
+PcrShadowReset (
+  IN EFI_TCG2_PROTOCOL  *Tcg2
+  )
+{
+  UINT8   Command[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT8   Response[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT32  ResponseSize;
+  UINT8   *Cursor;
+
+  Cursor = Command;
+  PutBe16 (&Cursor, TPM_ST_SESSIONS);
+  PutBe32 (&Cursor, 0);
+  PutBe32 (&Cursor, TPM_CC_PCR_Reset);
+  PutBe32 (&Cursor, PCR_SHADOW_TEST_PCR);
+  PutPasswordSession (&Cursor);
+
+  return PcrShadowSubmit (Tcg2, Command, Cursor, Response, &ResponseSize);
+}
+
+/**
+  Reads the PCR shadow counters of the TPM service.
+
+  @param[in]  FfaTestContext  Test context holding the partition IDs.
+  @param[out] Counters        Receives the PCR shadow counters.
+
+  @retval TRUE   The counters were read.
+  @retval FALSE  The TPM service does not share a partition with the test service.
+**/
+STATIC
+BOOLEAN
+PcrShadowGetCounters (
+  IN  FFA_TEST_CONTEXT          *FfaTestContext,
+  OUT PCR_SHADOW_TEST_COUNTERS  *Counters
+  )
+{
+  EFI_STATUS       Status;
+  DIRECT_MSG_ARGS  DirectMsgArgs;
+
+  if (!FfaTestContext->IsTestServiceAvailable ||
+      (FfaTestContext->FfaTestServicePartId != FfaTestContext->FfaTpm2ServicePartId))
+  {
+    return FALSE;
+  }
+
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg0 = TEST_OPCODE_GET_TELEMETRY;
+  Status             = ArmFfaLibMsgSendDirectReq2 (FfaTestContext->FfaTestServicePartId, &gEfiTestServiceFfaGuid, &DirectMsgArgs);
+  if (EFI_ERROR (Status) || (DirectMsgArgs.Arg0 != TEST_STATUS_SUCCESS)) {
+    return FALSE;
+  }
+
+  Counters->Hits          = DirectMsgArgs.Arg10;
+  Counters->Misses        = DirectMsgArgs.Arg11;
+  Counters->Resyncs       = DirectMsgArgs.Arg12;
+  Counters->Invalidations = DirectMsgArgs.Arg13;
+  return TRUE;
+}
+
+/**
+  This routine checks reads of a PCR stay coherent with extends and resets
+  while the TPM service may answer them from its PCR shadow.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaMiscTestTpmPcrShadow (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                Status;
+  EFI_TCG2_PROTOCOL         *Tcg2;
+  FFA_TEST_CONTEXT          *FfaTestContext;
+  UINT8                     First[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT8                     Second[PCR_SHADOW_TEST_BUFFER_SIZE];
+  UINT8                     Zero[SHA256_DIGEST_SIZE];
+  UINT32                    FirstSize;
+  UINT32                    SecondSize;
+  PCR_SHADOW_TEST_COUNTERS  Previous;
+  PCR_SHADOW_TEST_COUNTERS  Current;
+  BOOLEAN                   HaveCounters;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  FfaTestContext = (FFA_TEST_CONTEXT *)Context;
+  UT_ASSERT_NOT_NULL (FfaTestContext);
+
+  Status = gBS->LocateProtocol (&gEfiTcg2ProtocolGuid, NULL, (VOID **)&Tcg2);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "%a: TCG2 protocol not available (%r), skipping test.\n", __func__, Status));
+    return UNIT_TEST_SKIPPED;
+  }
+
+  HaveCounters = FixedPcdGetBool (PcdTpmServicePcrShadow) && PcrShadowGetCounters (FfaTestContext, &Previous);
+  if (!HaveCounters) {
+    DEBUG ((DEBUG_INFO, "%a: PCR shadow counters not available, only coherency is checked.\n", __func__));
+  }
+
+  // Back to back reads must match, the second one comes from the shadow
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowRead (Tcg2, First, &FirstSize));
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowRead (Tcg2, Second, &SecondSize));
+  UT_ASSERT_EQUAL (FirstSize, SecondSize);
+  UT_ASSERT_MEM_EQUAL (First, Second, FirstSize);
+  if (HaveCounters) {
+    UT_ASSERT_TRUE (PcrShadowGetCounters (FfaTestContext, &Current));
+    UT_ASSERT_TRUE (Current.Hits > Previous.Hits);
+    CopyMem (&Previous, &Current, sizeof (Previous));
+  }
+
+  // An extend must invalidate the PCR and be visible to the next read
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowExtend (Tcg2));
+  if (HaveCounters) {
+    UT_ASSERT_TRUE (PcrShadowGetCounters (FfaTestContext, &Current));
+    UT_ASSERT_TRUE (Current.Invalidations > Previous.Invalidations);
+    CopyMem (&Previous, &Current, sizeof (Previous));
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowRead (Tcg2, Second, &SecondSize));
+  UT_ASSERT_TRUE (CompareMem (First + PCR_READ_DIGEST_OFFSET, Second + PCR_READ_DIGEST_OFFSET, SHA256_DIGEST_SIZE) != 0);
+  if (HaveCounters) {
+    UT_ASSERT_TRUE (PcrShadowGetCounters (FfaTestContext, &Current));
+    UT_ASSERT_TRUE (Current.Misses > Previous.Misses);
+    CopyMem (&Previous, &Current, sizeof (Previous));
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowRead (Tcg2, First, &FirstSize));
+  UT_ASSERT_MEM_EQUAL (First, Second, FirstSize);
+
+  // A reset must discard the shadow and be visible to the next read
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowReset (Tcg2));
+  if (HaveCounters) {
+    UT_ASSERT_TRUE (PcrShadowGetCounters (FfaTestContext, &Current));
+    UT_ASSERT_TRUE (Current.Resyncs > Previous.Resyncs);
+    CopyMem (&Previous, &Current, sizeof (Previous));
+  }
+
+  ZeroMem (Zero, sizeof (Zero));
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowRead (Tcg2, First, &FirstSize));
+  UT_ASSERT_MEM_EQUAL (First + PCR_READ_DIGEST_OFFSET, Zero, SHA256_DIGEST_SIZE);
+  if (HaveCounters) {
+    UT_ASSERT_TRUE (PcrShadowGetCounters (FfaTestContext, &Current));
+    UT_ASSERT_TRUE (Current.Misses > Previous.Misses);
+    CopyMem (&Previous, &Current, sizeof (Previous));
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (PcrShadowRead (Tcg2, Second, &SecondSize));
+  UT_ASSERT_MEM_EQUAL (First, Second, FirstSize);
+  if (HaveCounters) {
+    UT_ASSERT_TRUE (PcrShadowGetCounters (FfaTestContext, &Current));
+    UT_ASSERT_TRUE (Current.Hits > Previous.Hits);
+  }
+
+  return UNIT_TEST_PASSED;
+}
@@ -0,0 +1,543 @@
+/** @file
+FfaPartitionSoak.c
+
+Long running soak test of the FF-A secure partition services.
+
+The soak repeatedly registers a notification mapping, triggers it through the
+test service, unregisters it and, when available, queries the TPM service
+interface version. Every PcdFfaSoakSampleIntervalSeconds the latency
+percentiles of each operation and the heap telemetry of the test SP are
+sampled, and a least-squares slope is kept over the windows so latency drift
+and heap growth can be reported once PcdFfaSoakDurationMinutes elapses.
+
+The soak is disabled when PcdFfaSoakDurationMinutes is 0.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Guid/NotificationServiceFfa.h>
+#include <Guid/TestServiceFfa.h>
+#include <Guid/Tpm2ServiceFfa.h>
+
+#include <Library/ArmFfaLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UnitTestLib.h>
+
+#include "FfaPartitionTestApp.h"
+
+// Notification mapping owned by the soak, must not collide with the functional test cases
+#define FFA_SOAK_SERVICE_UUID_LO  0xba7aff2eb1eac765
+#define FFA_SOAK_SERVICE_UUID_HI  0xb410b3a359f64054
+#define FFA_SOAK_COOKIE           0x50
+#define FFA_SOAK_NOTIFICATION_ID  20
+
+// Latency samples kept per operation and window, older samples are overwritten
+#define FFA_SOAK_WINDOW_SAMPLES  1024
+
+#define FFA_SOAK_NS_PER_SECOND  1000000000ULL
+
+typedef enum {
+  FfaSoakOpRegister,
+  FfaSoakOpNotify,
+  FfaSoakOpUnregister,
+  FfaSoakOpTpmVersion,
+  FfaSoakOpMax
+} FFA_SOAK_OP;
+
+///
+/// Running sums of a least-squares fit of y over the window index.
+///
+typedef struct {
+  UINT64    Count;
+  INT64     SumX;
+  INT64     SumY;
+  INT64     SumXX;
+  INT64     SumXY;
+} FFA_SOAK_TREND;
+
+///
+/// Heap and table usage of the test SP, see TEST_OPCODE_GET_TELEMETRY.
+///
+typedef struct {
+  UINT64    PoolBytesInUse;
+  UINT64    PoolAllocations;
+  UINT64    PoolFrees;
+  UINT64    FailedAllocations;
+  UINT64    TotalPages;
+  UINT64    FreePages;
+  UINT64    ServiceCount;
+  UINT64    MappingCount;
+  UINT64    ShrinkEvents;
+} FFA_SOAK_TELEMETRY;
+
+typedef struct {
+  UINT64            Samples[FFA_SOAK_WINDOW_SAMPLES];
+  UINTN             SampleCount;
+  UINT64            WindowCount;
+  UINT64            TotalCount;
+  UINT64            Failures;
+  FFA_SOAK_TREND    P99Trend;
+} FFA_SOAK_OP_STATE;
+
+STATIC CONST CHAR8  *mSoakOpNames[FfaSoakOpMax] = {
+  "Register",
+  "Notify",
+  "Unregister",
+  "TpmVersion"
+};
+
+STATIC FFA_SOAK_OP_STATE  mSoakOps[FfaSoakOpMax];
+
+/**
+  Adds a point to a least-squares trend.
+
+  @param[in, out] Trend  Trend to update.
+  @param[in]      X      Window index.
+  @param[in]      Y      Value sampled in that window.
+**/
+STATIC
+VOID
+SoakTrendAdd (
+  IN OUT FFA_SOAK_TREND  *Trend,
+  IN     INT64           X,
+  IN     INT64           Y
+  )
+{
+  Trend->Count++;
+  Trend->SumX  += X;
+  Trend->SumY  += Y;
+  Trend->SumXX += X * X;
+  Trend->SumXY += X * Y;
+}
+
+/**
+  Returns the least-squares slope of a trend.
+
+  @param[in] Trend  Trend to evaluate.
+
+  @retval The change of the sampled value per window, 0 with fewer than two windows.
+**/
+STATIC
+INT64
+SoakTrendSlope (
+  IN CONST FFA_SOAK_TREND  *Trend
+  )
+{
+  INT64  N;
+  INT64  Denominator;
+
+  N           = (INT64)Trend->Count;
+  Denominator = (N * Trend->SumXX) - (Trend->SumX * Trend->SumX);
+  if ((N < 2) || (Denominator == 0)) {
+    return 0;
+  }
+
+  return DivS64x64Remainder ((N * Trend->SumXY) - (Trend->SumX * Trend->SumY), Denominator, NULL);
+}
+
+/**
+  Records the latency of one soak operation in the current window.
+
+  @param[in] Op       Operation that was timed.
+  @param[in] Start    Time the operation was issued in nanoseconds.
+  @param[in] Success  Whether the operation returned the expected status.
+**/
+STATIC
+VOID
+SoakRecord (
+  IN FFA_SOAK_OP  Op,
+  IN UINT64       Start,
+  IN BOOLEAN      Success
+  )
+{
+  FFA_SOAK_OP_STATE  *State;
+
+  State = &mSoakOps[Op];
+  State->Samples[State->WindowCount % FFA_SOAK_WINDOW_SAMPLES] = FfaBenchmarkGetTimeNs () - Start;
+  State->WindowCount++;
+  State->TotalCount++;
+  if (State->SampleCount < FFA_SOAK_WINDOW_SAMPLES) {
+    State->SampleCount++;
+  }
+
+  if (!Success) {
+    State->Failures++;
+  }
+}
+
+/**
+  Registers or unregisters the soak notification mapping.
+
+  @param[in] PartId  Partition ID of the notification service.
+  @param[in] Opcode  NOTIFICATION_OPCODE_REGISTER or NOTIFICATION_OPCODE_UNREGISTER.
+
+  @retval TRUE   The notification service accepted the request.
+  @retval FALSE  The request failed.
+**/
+STATIC
+BOOLEAN
+SoakUpdateMapping (
+  IN UINT16  PartId,
+  IN UINT64  Opcode
+  )
+{
+  EFI_STATUS           Status;
+  DIRECT_MSG_ARGS      DirectMsgArgs;
+  NotificationMapping  Mapping;
+
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  Mapping.Uint64      = 0;
+  Mapping.Bits.Cookie = FFA_SOAK_COOKIE;
+  Mapping.Bits.Id     = FFA_SOAK_NOTIFICATION_ID;
+  DirectMsgArgs.Arg3  = FFA_SOAK_SERVICE_UUID_LO;
+  DirectMsgArgs.Arg4  = FFA_SOAK_SERVICE_UUID_HI;
+  DirectMsgArgs.Arg5  = Opcode;
+  DirectMsgArgs.Arg6  = 1;
+  DirectMsgArgs.Arg7  = Mapping.Uint64;
+  Status              = ArmFfaLibMsgSendDirectReq2 (PartId, &gEfiNotificationServiceFfaGuid, &DirectMsgArgs);
+
+  return !EFI_ERROR (Status) && ((INT8)DirectMsgArgs.Arg6 == NOTIFICATION_STATUS_SUCCESS);
+}
+
+/**
+  Asks the test service to signal the soak notification mapping.
+
+  @param[in] PartId  Partition ID of the test service.
+
+  @retval TRUE   The notification was set.
+  @retval FALSE  The request failed.
+**/
+STATIC
+BOOLEAN
+SoakNotify (
+  IN UINT16  PartId
+  )
+{
+  EFI_STATUS       Status;
+  DIRECT_MSG_ARGS  DirectMsgArgs;
+
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg0 = TEST_OPCODE_TEST_NOTIFICATION;
+  DirectMsgArgs.Arg1 = FFA_SOAK_SERVICE_UUID_LO;
+  DirectMsgArgs.Arg2 = FFA_SOAK_SERVICE_UUID_HI;
+  DirectMsgArgs.Arg3 = FFA_SOAK_COOKIE;
+  Status             = ArmFfaLibMsgSendDirectReq2 (PartId, &gEfiTestServiceFfaGuid, &DirectMsgArgs);
+
+  return !EFI_ERROR (Status) && (DirectMsgArgs.Arg0 == TEST_STATUS_SUCCESS);
+}
+
+/**
+  Queries the TPM service interface version.
+
+  @param[in] PartId  Partition ID of the TPM service.
+
+  @retval TRUE   The TPM service returned its version.
+  @retval FALSE  The request failed.
+**/
+STATIC
+BOOLEAN
+SoakTpmVersion (
+  IN UINT16  PartId
+  )
+{
+  EFI_STATUS       Status;
+  DIRECT_MSG_ARGS  DirectMsgArgs;
+
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg0 = TPM2_FFA_GET_INTERFACE_VERSION;
+  Status             = ArmFfaLibMsgSendDirectReq2 (PartId, &gTpm2ServiceFfaGuid, &DirectMsgArgs);
+
+  return !EFI_ERROR (Status) && (DirectMsgArgs.Arg0 == TPM2_FFA_SUCCESS_OK_RESULTS_RETURNED);
+}
+
+/**
+  Reads the heap and notification table telemetry of the test SP.
+
+  @param[in]  PartId     Partition ID of the test service.
+  @param[out] Telemetry  Receives the telemetry.
+
+  @retval TRUE   The telemetry was read.
+  @retval FALSE  The test SP does not support TEST_OPCODE_GET_TELEMETRY.
+**/
+STATIC
+BOOLEAN
+SoakGetTelemetry (
+  IN  UINT16              PartId,
+  OUT FFA_SOAK_TELEMETRY  *Telemetry
+  )
+{
+  EFI_STATUS       Status;
+  DIRECT_MSG_ARGS  DirectMsgArgs;
+
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg0 = TEST_OPCODE_GET_TELEMETRY;
+  Status             = ArmFfaLibMsgSendDirectReq2 (PartId, &gEfiTestServiceFfaGuid, &DirectMsgArgs);
+  if (EFI_ERROR (Status) || (DirectMsgArgs.Arg0 != TEST_STATUS_SUCCESS)) {
+    return FALSE;
+  }
+
+  Telemetry->PoolBytesInUse    = DirectMsgArgs.Arg1;
+  Telemetry->PoolAllocations   = DirectMsgArgs.Arg2;
+  Telemetry->PoolFrees         = DirectMsgArgs.Arg3;
+  Telemetry->FailedAllocations = DirectMsgArgs.Arg4;
+  Telemetry->TotalPages        = DirectMsgArgs.Arg5;
+  Telemetry->FreePages         = DirectMsgArgs.Arg6;
+  Telemetry->ServiceCount      = DirectMsgArgs.Arg7;
+  Telemetry->MappingCount      = DirectMsgArgs.Arg8;
+  Telemetry->ShrinkEvents      = DirectMsgArgs.Arg9;
+  return TRUE;
+}
+
+/**
+  Closes a sample window, folding its p99 into the latency trends.
+
+  @param[in] Window  Index of the window being closed.
+**/
+STATIC
+VOID
+SoakCloseWindow (
+  IN UINTN  Window
+  )
+{
+  UINTN              Op;
+  UINT64             P50;
+  UINT64             P99;
+  FFA_SOAK_OP_STATE  *State;
+
+  for (Op = 0; Op < FfaSoakOpMax; Op++) {
+    State = &mSoakOps[Op];
+    if (State->SampleCount == 0) {
+      continue;
+    }
+
+    FfaBenchmarkSortSamples (State->Samples, State->SampleCount);
+    P50 = FfaBenchmarkPercentile (State->Samples, State->SampleCount, 50);
+    P99 = FfaBenchmarkPercentile (State->Samples, State->SampleCount, 99);
+    SoakTrendAdd (&State->P99Trend, (INT64)Window, (INT64)P99);
+
+    DEBUG ((DEBUG_INFO, "Soak window %u: %a p50=%lu p99=%lu ns (%lu total)\n", (UINT32)Window, mSoakOpNames[Op], P50, P99, State->TotalCount));
+
+    // The next window starts over at the beginning of the sample buffer
+    State->SampleCount = 0;
+    State->WindowCount = 0;
+  }
+}
+
+/**
+  Helper prerequisite function to proceed with the soak test.
+
+  @retval  UNIT_TEST_PASSED                      Unit test case prerequisites
+                                                 are met.
+  @retval  UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  Test case should be skipped.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CheckSoakEnabled (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_TEST_CONTEXT  *FfaTestContext;
+
+  FfaTestContext = (FFA_TEST_CONTEXT *)Context;
+  UT_ASSERT_NOT_NULL (FfaTestContext);
+
+  if (FixedPcdGet32 (PcdFfaSoakDurationMinutes) == 0) {
+    DEBUG ((DEBUG_INFO, "%a: Soak disabled, skipping test.\n", __func__));
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  if (!FfaTestContext->IsNotificationServiceAvailable || !FfaTestContext->IsTestServiceAvailable) {
+    DEBUG ((DEBUG_INFO, "%a: Notification or Test Service not available, skipping test.\n", __func__));
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Runs the soak traffic and reports its latency and SP heap trends.
+
+  @param[in] FfaTestContext  Test context holding the partition IDs.
+  @param[in] UseTpm          Whether TPM service traffic is part of the soak.
+**/
+STATIC
+UNIT_TEST_STATUS
+SoakRun (
+  IN FFA_TEST_CONTEXT  *FfaTestContext,
+  IN BOOLEAN           UseTpm
+  )
+{
+  BOOLEAN             HasTelemetry;
+  FFA_SOAK_TELEMETRY  StartTelemetry;
+  FFA_SOAK_TELEMETRY  Telemetry;
+  FFA_SOAK_TREND      HeapTrend;
+  UINT64              SoakEnd;
+  UINT64              WindowLength;
+  UINT64              WindowEnd;
+  UINT64              Start;
+  UINT64              Now;
+  UINTN               Window;
+  UINTN               Op;
+  UINT64              Failures;
+  INT64               Slope;
+  CHAR8               Name[FFA_BENCH_NAME_LENGTH];
+
+  ZeroMem (mSoakOps, sizeof (mSoakOps));
+  ZeroMem (&HeapTrend, sizeof (HeapTrend));
+  HasTelemetry = SoakGetTelemetry (FfaTestContext->FfaTestServicePartId, &StartTelemetry);
+  if (!HasTelemetry) {
+    UT_LOG_WARNING ("Test SP does not report telemetry, only latency trends are tracked.");
+  }
+
+  WindowLength = MultU64x32 (FFA_SOAK_NS_PER_SECOND, FixedPcdGet32 (PcdFfaSoakSampleIntervalSeconds));
+  Now          = FfaBenchmarkGetTimeNs ();
+  SoakEnd      = Now + MultU64x32 (MultU64x32 (FFA_SOAK_NS_PER_SECOND, 60), FixedPcdGet32 (PcdFfaSoakDurationMinutes));
+  WindowEnd    = Now + WindowLength;
+  Window       = 0;
+
+  UT_LOG_INFO ("Soaking for %u minutes, sampling every %u seconds", FixedPcdGet32 (PcdFfaSoakDurationMinutes), FixedPcdGet32 (PcdFfaSoakSampleIntervalSeconds));
+
+  while (Now < SoakEnd) {
+    Start = FfaBenchmarkGetTimeNs ();
+    SoakRecord (FfaSoakOpRegister, Start, SoakUpdateMapping (FfaTestContext->FfaNotificationServicePartId, NOTIFICATION_OPCODE_REGISTER));
+
+    Start = FfaBenchmarkGetTimeNs ();
+    SoakRecord (FfaSoakOpNotify, Start, SoakNotify (FfaTestContext->FfaTestServicePartId));
+
+    Start = FfaBenchmarkGetTimeNs ();
+    SoakRecord (FfaSoakOpUnregister, Start, SoakUpdateMapping (FfaTestContext->FfaNotificationServicePartId, NOTIFICATION_OPCODE_UNREGISTER));
+
+    if (UseTpm) {
+      Start = FfaBenchmarkGetTimeNs ();
+      SoakRecord (FfaSoakOpTpmVersion, Start, SoakTpmVersion (FfaTestContext->FfaTpm2ServicePartId));
+    }
+
+    Now = FfaBenchmarkGetTimeNs ();
+    if ((Now >= WindowEnd) && (Now < SoakEnd)) {
+      SoakCloseWindow (Window);
+      if (HasTelemetry && SoakGetTelemetry (FfaTestContext->FfaTestServicePartId, &Telemetry)) {
+        SoakTrendAdd (&HeapTrend, (INT64)Window, (INT64)Telemetry.PoolBytesInUse);
+        DEBUG ((
+          DEBUG_INFO,
+          "Soak window %u: heap %lu bytes, %lu/%lu pages free, %lu mappings\n",
+          (UINT32)Window,
+          Telemetry.PoolBytesInUse,
+          Telemetry.FreePages,
+          Telemetry.TotalPages,
+          Telemetry.MappingCount
+          ));
+      }
+
+      Window++;
+      WindowEnd = Now + WindowLength;
+    }
+  }
+
+  // The final window feeds the trends and becomes the recorded benchmark result
+  Failures = 0;
+  for (Op = 0; Op < FfaSoakOpMax; Op++) {
+    if (mSoakOps[Op].SampleCount == 0) {
+      continue;
+    }
+
+    FfaBenchmarkSortSamples (mSoakOps[Op].Samples, mSoakOps[Op].SampleCount);
+    SoakTrendAdd (
+      &mSoakOps[Op].P99Trend,
+      (INT64)Window,
+      (INT64)FfaBenchmarkPercentile (mSoakOps[Op].Samples, mSoakOps[Op].SampleCount, 99)
+      );
+
+    AsciiSPrint (Name, sizeof (Name), "Soak.%a", mSoakOpNames[Op]);
+    FfaBenchmarkReport (Name, mSoakOps[Op].Samples, mSoakOps[Op].SampleCount);
+
+    Slope = SoakTrendSlope (&mSoakOps[Op].P99Trend);
+    UT_LOG_INFO ("%a: %lu requests, %lu failed, p99 slope %ld ns/window", Name, mSoakOps[Op].TotalCount, mSoakOps[Op].Failures, Slope);
+    if (Slope > 0) {
+      UT_LOG_WARNING ("%a: p99 latency grew over %u windows", Name, (UINT32)(Window + 1));
+    }
+
+    Failures += mSoakOps[Op].Failures;
+  }
+
+  UT_ASSERT_EQUAL (Failures, 0);
+
+  if (HasTelemetry) {
+    UT_ASSERT_TRUE (SoakGetTelemetry (FfaTestContext->FfaTestServicePartId, &Telemetry));
+    SoakTrendAdd (&HeapTrend, (INT64)Window, (INT64)Telemetry.PoolBytesInUse);
+
+    Slope = SoakTrendSlope (&HeapTrend);
+    UT_LOG_INFO (
+      "SP heap: %lu -> %lu bytes live, slope %ld bytes/window, %lu allocations, %lu frees",
+      StartTelemetry.PoolBytesInUse,
+      Telemetry.PoolBytesInUse,
+      Slope,
+      Telemetry.PoolAllocations - StartTelemetry.PoolAllocations,
+      Telemetry.PoolFrees - StartTelemetry.PoolFrees
+      );
+    if (Slope > 0) {
+      UT_LOG_WARNING ("SP live heap grew over %u windows", (UINT32)(Window + 1));
+    }
+
+    if (Telemetry.ShrinkEvents != StartTelemetry.ShrinkEvents) {
+      UT_LOG_WARNING ("SP heap came under memory pressure, %lu shrink events", Telemetry.ShrinkEvents - StartTelemetry.ShrinkEvents);
+    }
+
+    // Every soak cycle unregisters what it registered, so the tables must end where they started
+    UT_ASSERT_EQUAL (Telemetry.FailedAllocations, StartTelemetry.FailedAllocations);
+    UT_ASSERT_EQUAL (Telemetry.MappingCount, StartTelemetry.MappingCount);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  This routine runs mixed notification, test service and TPM traffic for the
+  configured soak duration and reports latency and SP heap trends.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfSoak (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS        Status;
+  UNIT_TEST_STATUS  UtStatus;
+  FFA_TEST_CONTEXT  *FfaTestContext;
+  BOOLEAN           UseTpm;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  FfaTestContext = (FFA_TEST_CONTEXT *)Context;
+  UT_ASSERT_NOT_NULL (FfaTestContext);
+
+  UseTpm = FfaTestContext->IsTpm2ServiceAvailable;
+ #ifndef TPM2_ENABLE
+  UseTpm = FALSE;
+ #endif // TPM2_ENABLE
+
+  // Notifications for the soak mapping are delivered through the SRI handler of the functional cases
+  Status = FfaNotificationBind (FfaTestContext->FfaTestServicePartId, 0, LShiftU64 (1, FFA_SOAK_NOTIFICATION_ID));
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Unable to bind soak notification with FF-A Ffa test SP (%r).\n", Status));
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  UtStatus = SoakRun (FfaTestContext, UseTpm);
+
+  // Release the binding whatever the outcome, later cases must not inherit it
+  Status = FfaNotificationUnbind (FfaTestContext->FfaTestServicePartId, LShiftU64 (1, FFA_SOAK_NOTIFICATION_ID));
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Unable to unbind soak notification with FF-A Ffa test SP (%r).\n", Status));
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  return UtStatus;
+}
@@ -12,9 +12,12 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <IndustryStandard/ArmFfaSvc.h>
 #include <IndustryStandard/ArmFfaBootInfo.h>
 #include <IndustryStandard/ArmFfaPartInfo.h>
+#include <IndustryStandard/Tpm20.h>
+#include <IndustryStandard/TpmPtp.h>
 #include <Pi/PiMultiPhase.h>
 #include <Protocol/HardwareInterrupt.h>
 #include <Protocol/MmCommunication2.h>
+#include <Protocol/Tcg2Protocol.h>
 #include <Guid/NotificationServiceFfa.h>
 #include <Guid/TestServiceFfa.h>
 #include <Guid/Tpm2ServiceFfa.h>
@@ -28,26 +31,21 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/IoLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/PrintLib.h>
 #include <Library/UefiLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UnitTestLib.h>
 
+#include "FfaPartitionTestApp.h"
+
 #define UNIT_TEST_APP_NAME     "FF-A Functional Test"
 #define UNIT_TEST_APP_VERSION  "0.1"
 
-typedef struct {
-  BOOLEAN    IsMmCommunicationServiceAvailable;
-  BOOLEAN    IsTestServiceAvailable;
-  BOOLEAN    IsTpm2ServiceAvailable;
-  BOOLEAN    IsNotificationServiceAvailable;
-  UINT16     FfaMmCommunicationPartId;
-  UINT16     FfaTestServicePartId;
-  UINT16     FfaTpm2ServicePartId;
-  UINT16     FfaNotificationServicePartId;
-  UINTN      SriIndex;
-} FFA_TEST_CONTEXT;
+// Period of the timer raising the CRB cancel during a TPM command, in 100ns units
+#define TPM_CANCEL_PERIOD  (10 * 1000 * 10)
 
 UINT16                           FfaPartId;
 EFI_HARDWARE_INTERRUPT_PROTOCOL  *gInterrupt;
@@ -1141,6 +1139,125 @@ FfaMiscTestNotificationEvent (
   return UNIT_TEST_PASSED;
 }
 
+/**
+  Removes every notification mapping owned by a source through the notification service.
+
+  @param[in]  PartId    Partition ID of the notification service.
+  @param[in]  UuidLo    Lower bytes of the service UUID, 0 with UuidHi for all services.
+  @param[in]  UuidHi    Higher bytes of the service UUID.
+  @param[in]  SourceId  ID of the source whose mappings are removed.
+  @param[out] Removed   Number of mappings removed.
+
+  @retval The notification service status, NOTIFICATION_STATUS_NOT_SUPPORTED if the
+          request could not be sent.
+**/
+STATIC
+INT8
+UnregisterSourceMappings (
+  IN  UINT16  PartId,
+  IN  UINT64  UuidLo,
+  IN  UINT64  UuidHi,
+  IN  UINT16  SourceId,
+  OUT UINTN   *Removed
+  )
+{
+  DIRECT_MSG_ARGS  DirectMsgArgs;
+  EFI_STATUS       Status;
+
+  *Removed = 0;
+
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  /* x4-x6 (i.e. Arg0-Arg2) should be 0 */
+  DirectMsgArgs.Arg3 = UuidLo;
+  DirectMsgArgs.Arg4 = UuidHi;
+  DirectMsgArgs.Arg5 = NOTIFICATION_OPCODE_UNREGISTER_SOURCE;
+  DirectMsgArgs.Arg6 = SourceId;
+  Status             = ArmFfaLibMsgSendDirectReq2 (
+                         PartId,
+                         &gEfiNotificationServiceFfaGuid,
+                         &DirectMsgArgs
+                         );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Unable to communicate direct req 2 with FF-A Ffa test SP (%r).\n", Status));
+    return NOTIFICATION_STATUS_NOT_SUPPORTED;
+  }
+
+  *Removed = DirectMsgArgs.Arg7;
+  return (INT8)DirectMsgArgs.Arg6;
+}
+
+/**
+  This routine tests the inter-partition communication with the Ffa test SP
+  and removes all remaining notification mappings of this application in bulk.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaMiscTestInterPartitionUnregisterSource (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS   DirectMsgArgs;
+  EFI_STATUS        Status;
+  INT8              ResponseVal;
+  UINT16            SourceId;
+  UINTN             Removed;
+  FFA_TEST_CONTEXT  *FfaTestContext;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  FfaTestContext = (FFA_TEST_CONTEXT *)Context;
+  UT_ASSERT_NOT_NULL (FfaTestContext);
+
+  Status = ArmFfaLibPartitionIdGet (&SourceId);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // Unregister Source needs the 3-bit opcode decode of interface version 1.1
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg5 = NOTIFICATION_OPCODE_GET_VERSION;
+  Status             = ArmFfaLibMsgSendDirectReq2 (
+                         FfaTestContext->FfaNotificationServicePartId,
+                         &gEfiNotificationServiceFfaGuid,
+                         &DirectMsgArgs
+                         );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  if ((INT8)DirectMsgArgs.Arg6 != NOTIFICATION_STATUS_SUCCESS) {
+    // Version 1.0 services, like the Rust Notify service, do not implement GET_VERSION
+    DEBUG ((DEBUG_INFO, "%a Notification Service has no version, skipping.\n", __func__));
+    UT_LOG_WARNING ("Notification Service has no version, skipping.");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  if (DirectMsgArgs.Arg7 < ((NOTIFICATION_SERVICE_MAJOR_VER << 16) | NOTIFICATION_SERVICE_MINOR_VER)) {
+    DEBUG ((DEBUG_INFO, "%a Notification Service version %x has no Unregister Source, skipping.\n", __func__, DirectMsgArgs.Arg7));
+    UT_LOG_WARNING ("Notification Service version %x has no Unregister Source, skipping.", DirectMsgArgs.Arg7);
+    return UNIT_TEST_SKIPPED;
+  }
+
+  // Remove the Thermal Service Notification Mappings left, Cookie0 and Cookie2
+  ResponseVal = UnregisterSourceMappings (
+                  FfaTestContext->FfaNotificationServicePartId,
+                  0xba7aff2eb1eac765,
+                  0xb610b3a359f64054,
+                  SourceId,
+                  &Removed
+                  );
+  UT_ASSERT_EQUAL (ResponseVal, NOTIFICATION_STATUS_SUCCESS);
+  UT_ASSERT_EQUAL (Removed, 2);
+
+  // Remove the mappings of every service, only the Battery Service ones are left
+  ResponseVal = UnregisterSourceMappings (FfaTestContext->FfaNotificationServicePartId, 0, 0, SourceId, &Removed);
+  UT_ASSERT_EQUAL (ResponseVal, NOTIFICATION_STATUS_SUCCESS);
+  UT_ASSERT_EQUAL (Removed, 5);
+
+  // Nothing is left to remove
+  ResponseVal = UnregisterSourceMappings (FfaTestContext->FfaNotificationServicePartId, 0, 0, SourceId, &Removed);
+  UT_ASSERT_EQUAL (ResponseVal, NOTIFICATION_STATUS_SUCCESS);
+  UT_ASSERT_EQUAL (Removed, 0);
+
+  DEBUG ((DEBUG_INFO, "Unregister Source Success\n"));
+  return UNIT_TEST_PASSED;
+}
+
 /**
   This routine tests the TPM version retrieval with the Ffa test SP.
 **/
@@ -1226,6 +1343,246 @@ FfaMiscTestTpmCloseLocality (
   return UNIT_TEST_PASSED;
 }
 
+/**
+  Timer notification raising the cancel request of the client CRB.
+
+  @param  Event    The timer event.
+  @param  Context  The CrbControlCancel register of the client CRB.
+**/
+STATIC
+VOID
+EFIAPI
+TpmCancelNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  MmioWrite32 ((UINTN)Context, PTP_CRB_CONTROL_CANCEL);
+}
+
+/**
+  This routine tests a client cancel of a TPM command in flight.
+
+  A full TPM2_SelfTest is sent through the TCG2 protocol while a timer keeps
+  setting CrbControlCancel. The TPM service must then answer TPM_RC_CANCELED.
+  A TPM that completes the self test before the cancel is seen skips the test.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaMiscTestTpmCancel (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS             Status;
+  EFI_TCG2_PROTOCOL      *Tcg2;
+  EFI_EVENT              CancelEvent;
+  PTP_CRB_REGISTERS_PTR  Crb;
+  UINT8                  Command[sizeof (TPM2_COMMAND_HEADER) + sizeof (TPMI_YES_NO)];
+  TPM2_COMMAND_HEADER    *Header;
+  TPM2_RESPONSE_HEADER   Response;
+  UINT32                 ResponseCode;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  Status = gBS->LocateProtocol (&gEfiTcg2ProtocolGuid, NULL, (VOID **)&Tcg2);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "%a: TCG2 protocol not available (%r), skipping test.\n", __func__, Status));
+    return UNIT_TEST_SKIPPED;
+  }
+
+  Crb = (PTP_CRB_REGISTERS_PTR)(UINTN)PcdGet64 (PcdTpmBaseAddress);
+
+  Header              = (TPM2_COMMAND_HEADER *)Command;
+  Header->tag         = SwapBytes16 (TPM_ST_NO_SESSIONS);
+  Header->paramSize   = SwapBytes32 (sizeof (Command));
+  Header->commandCode = SwapBytes32 (TPM_CC_SelfTest);
+
+  // fullTest, every algorithm is tested which keeps the TPM busy the longest
+  Command[sizeof (TPM2_COMMAND_HEADER)] = YES;
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  TpmCancelNotify,
+                  &Crb->CrbControlCancel,
+                  &CancelEvent
+                  );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Status = gBS->SetTimer (CancelEvent, TimerPeriodic, TPM_CANCEL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (CancelEvent);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  ZeroMem (&Response, sizeof (Response));
+  Status = Tcg2->SubmitCommand (Tcg2, sizeof (Command), Command, sizeof (Response), (UINT8 *)&Response);
+
+  // Withdraw the cancel so it cannot reach the next command
+  gBS->CloseEvent (CancelEvent);
+  MmioWrite32 ((UINTN)&Crb->CrbControlCancel, 0);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Unable to submit TPM2_SelfTest (%r).\n", __func__, Status));
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  ResponseCode = SwapBytes32 (Response.responseCode);
+  if (ResponseCode == TPM_RC_SUCCESS) {
+    UT_LOG_WARNING ("TPM2_SelfTest completed before the cancel was seen, skipping test.");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  if (ResponseCode != TPM_RC_CANCELED) {
+    DEBUG ((DEBUG_ERROR, "%a: Unexpected TPM response code %x\n", __func__, ResponseCode));
+    UT_ASSERT_EQUAL (ResponseCode, TPM_RC_CANCELED);
+  }
+
+  UT_ASSERT_EQUAL (SwapBytes32 (Response.paramSize), sizeof (TPM2_RESPONSE_HEADER));
+
+  DEBUG ((DEBUG_INFO, "TPM Service Cancel Success\n"));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  This routine tests a deadline bounded direct request to the TPM Service.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaMiscTestDirectReqDeadline (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX                  DirectMsgArgs;
+  EFI_STATUS                          Status;
+  FFA_TEST_CONTEXT                    *FfaTestContext;
+  FFA_DIRECT_REQ_DEADLINE_STATISTICS  StatsBefore;
+  FFA_DIRECT_REQ_DEADLINE_STATISTICS  StatsAfter;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  FfaTestContext = (FFA_TEST_CONTEXT *)Context;
+  UT_ASSERT_NOT_NULL (FfaTestContext);
+
+  FfaDirectReqDeadlineGetStatistics (&StatsBefore);
+
+  // Call the TPM Service get_interface_version with a one second deadline
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg0 = TPM2_FFA_GET_INTERFACE_VERSION;
+  Status             = FfaMessageSendDirectReq2Deadline (
+                         FfaTestContext->FfaTpm2ServicePartId,
+                         &gTpm2ServiceFfaGuid,
+                         &DirectMsgArgs,
+                         1000000000
+                         );
+  if (Status == EFI_UNSUPPORTED) {
+    DEBUG ((DEBUG_INFO, "%a: Performance counter not running, skipping test.\n", __func__));
+    return UNIT_TEST_SKIPPED;
+  }
+
+  if (Status == EFI_TIMEOUT) {
+    // The request was interrupted past its deadline, collect the response without one
+    DEBUG ((DEBUG_INFO, "Direct request abandoned, resuming it\n"));
+    Status = FfaMessageResumeDirectReq2 (&DirectMsgArgs, MAX_UINT64);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (DirectMsgArgs.Arg0, TPM2_FFA_SUCCESS_OK_RESULTS_RETURNED);
+
+  // Nothing is left to resume once the response was received
+  Status = FfaMessageResumeDirectReq2 (&DirectMsgArgs, MAX_UINT64);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  FfaDirectReqDeadlineGetStatistics (&StatsAfter);
+  DEBUG ((
+    DEBUG_INFO,
+    "Deadline requests: %ld, interrupts: %ld, timeouts: %ld\n",
+    StatsAfter.Requests - StatsBefore.Requests,
+    StatsAfter.Interrupts - StatsBefore.Interrupts,
+    StatsAfter.Timeouts - StatsBefore.Timeouts
+    ));
+  UT_ASSERT_EQUAL (StatsAfter.Requests, StatsBefore.Requests + 1);
+  UT_ASSERT_EQUAL (StatsAfter.Completed, StatsBefore.Completed + 1);
+  UT_ASSERT_EQUAL (StatsAfter.Resumes - StatsBefore.Resumes, StatsAfter.Timeouts - StatsBefore.Timeouts);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  This routine tests a slow direct request to the Test Service is abandoned once
+  its deadline expired and that its response can be collected by resuming it.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaMiscTestDirectReqExpiredDeadline (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX                  DirectMsgArgs;
+  EFI_STATUS                          Status;
+  FFA_TEST_CONTEXT                    *FfaTestContext;
+  FFA_DIRECT_REQ_DEADLINE_STATISTICS  StatsBefore;
+  FFA_DIRECT_REQ_DEADLINE_STATISTICS  StatsAfter;
+
+  DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
+
+  FfaTestContext = (FFA_TEST_CONTEXT *)Context;
+  UT_ASSERT_NOT_NULL (FfaTestContext);
+
+  FfaDirectReqDeadlineGetStatistics (&StatsBefore);
+
+  // Keep the Test Service busy for half a second with a deadline that has already expired
+  ZeroMem (&DirectMsgArgs, sizeof (DirectMsgArgs));
+  DirectMsgArgs.Arg0 = TEST_OPCODE_BUSY_WAIT;
+  DirectMsgArgs.Arg1 = TEST_BUSY_WAIT_MAX_US / 2;
+  Status             = FfaMessageSendDirectReq2Deadline (
+                         FfaTestContext->FfaTestServicePartId,
+                         &gEfiTestServiceFfaGuid,
+                         &DirectMsgArgs,
+                         0
+                         );
+  if (Status == EFI_UNSUPPORTED) {
+    DEBUG ((DEBUG_INFO, "%a: Performance counter not running, skipping test.\n", __func__));
+    return UNIT_TEST_SKIPPED;
+  }
+
+  if (Status == EFI_SUCCESS) {
+    // Only a request that hands control back before its response can be abandoned
+    DEBUG ((DEBUG_WARN, "%a: Test Service was not preempted, nothing to abandon.\n", __func__));
+    UT_ASSERT_EQUAL (DirectMsgArgs.Arg0, TEST_STATUS_SUCCESS);
+    FfaDirectReqDeadlineGetStatistics (&StatsAfter);
+    UT_ASSERT_EQUAL (StatsAfter.Timeouts, StatsBefore.Timeouts);
+    UT_LOG_WARNING ("Test Service was not preempted, the deadline was never checked, skipping test.");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+  FfaDirectReqDeadlineGetStatistics (&StatsAfter);
+  UT_ASSERT_EQUAL (StatsAfter.Timeouts, StatsBefore.Timeouts + 1);
+  UT_ASSERT_EQUAL (StatsAfter.Resumes, StatsBefore.Resumes);
+
+  // The Test Service is still busy with the abandoned request
+  Status = FfaMessageSendDirectReq2Deadline (
+             FfaTestContext->FfaTestServicePartId,
+             &gEfiTestServiceFfaGuid,
+             &DirectMsgArgs,
+             MAX_UINT64
+             );
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_READY);
+
+  // Collect the response without a deadline
+  Status = FfaMessageResumeDirectReq2 (&DirectMsgArgs, MAX_UINT64);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (DirectMsgArgs.Arg0, TEST_STATUS_SUCCESS);
+
+  FfaDirectReqDeadlineGetStatistics (&StatsAfter);
+  UT_ASSERT_EQUAL (StatsAfter.Timeouts, StatsBefore.Timeouts + 1);
+  UT_ASSERT_EQUAL (StatsAfter.Resumes, StatsBefore.Resumes + 1);
+  UT_ASSERT_EQUAL (StatsAfter.Completed, StatsBefore.Completed + 1);
+
+  return UNIT_TEST_PASSED;
+}
+
 /**
   This routine tests the FFA_NS_RES_INFO_GET command.
 **/
@@ -1322,6 +1679,7 @@ FfaPartitionTestAppEntry (
   EFI_STATUS                  Status;
   UNIT_TEST_FRAMEWORK_HANDLE  Fw             = NULL;
   UNIT_TEST_SUITE_HANDLE      Misc           = NULL;
+  UNIT_TEST_SUITE_HANDLE      Perf           = NULL;
   FFA_TEST_CONTEXT            FfaTestContext = { 0 };
 
   DEBUG ((DEBUG_ERROR, "%a %a v%a\n", __FUNCTION__, UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
@@ -1588,6 +1946,21 @@ FfaPartitionTestAppEntry (
     goto Done;
   }
 
+  Status = AddTestCase (
+             Misc,
+             "Verify Ffa Inter Partition",
+             "Ffa.Miscellaneous.FfaTestInterPartitionUnregisterSource",
+             FfaMiscTestInterPartitionUnregisterSource,
+             CheckNotificationService,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for FfaTestInterPartitionUnregisterSource\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
   //
   // As a system level test, the order of the tests is important as the tests will
   // will corporate the states of TPM service to test the Ffa test SP.
@@ -1622,6 +1995,66 @@ FfaPartitionTestAppEntry (
     goto Done;
   }
 
+  Status = AddTestCase (
+             Misc,
+             "Verify Ffa TPM Service Cancel",
+             "Ffa.Miscellaneous.FfaTestTpmCancel",
+             FfaMiscTestTpmCancel,
+             CheckTPMService,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for FfaTestTpmCancel\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = AddTestCase (
+             Misc,
+             "Verify Ffa TPM Service PCR Shadow",
+             "Ffa.Miscellaneous.FfaTestTpmPcrShadow",
+             FfaMiscTestTpmPcrShadow,
+             CheckTPMService,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for FfaTestTpmPcrShadow\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = AddTestCase (
+             Misc,
+             "Verify deadline bounded direct requests",
+             "Ffa.Miscellaneous.FfaTestDirectReqDeadline",
+             FfaMiscTestDirectReqDeadline,
+             CheckTPMService,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for FfaTestDirectReqDeadline\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = AddTestCase (
+             Misc,
+             "Verify direct requests past an expired deadline",
+             "Ffa.Miscellaneous.FfaTestDirectReqExpiredDeadline",
+             FfaMiscTestDirectReqExpiredDeadline,
+             CheckTestService,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for FfaTestDirectReqExpiredDeadline\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
   Status = AddTestCase (
              Misc,
              "Verify FFA_NS_RES_INFO_GET",
@@ -1637,6 +2070,79 @@ FfaPartitionTestAppEntry (
     goto Done;
   }
 
+  // Performance test suite, runs after the functional cases have discovered the services.
+  Status = CreateUnitTestSuite (&Perf, Fw, "FF-A Performance Test cases", "Ffa.Performance", NULL, NULL);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in CreateUnitTestSuite for PerfSuite\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = AddTestCase (
+             Perf,
+             "Benchmark partition discovery via registers and Rx/Tx buffers",
+             "Ffa.Performance.PartitionDiscovery",
+             FfaPerfPartitionDiscovery,
+             NULL,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for PartitionDiscovery\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = AddTestCase (
+             Perf,
+             "Soak mixed FF-A traffic and report latency and heap trends",
+             "Ffa.Performance.Soak",
+             FfaPerfSoak,
+             CheckSoakEnabled,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for Soak\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  //
+  // Persisting and checking the results must stay last in the suite so they cover
+  // every benchmark above.
+  //
+  Status = AddTestCase (
+             Perf,
+             "Save benchmark results",
+             "Ffa.Performance.SaveResults",
+             FfaPerfSaveResults,
+             NULL,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for SaveResults\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  Status = AddTestCase (
+             Perf,
+             "Check benchmark results against baseline",
+             "Ffa.Performance.CheckBaseline",
+             FfaPerfCheckBaseline,
+             NULL,
+             NULL,
+             &FfaTestContext
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in AddTestCase for CheckBaseline\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
   //
   // Execute the tests.
   //
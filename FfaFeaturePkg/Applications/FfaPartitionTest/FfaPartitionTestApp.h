@@ -0,0 +1,165 @@
+/** @file
+FfaPartitionTestApp.h
+
+Shared definitions for the FF-A partition test application.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef FFA_PARTITION_TEST_APP_H_
+#define FFA_PARTITION_TEST_APP_H_
+
+#include <Uefi.h>
+#include <Library/UnitTestLib.h>
+
+typedef struct {
+  BOOLEAN    IsMmCommunicationServiceAvailable;
+  BOOLEAN    IsTestServiceAvailable;
+  BOOLEAN    IsTpm2ServiceAvailable;
+  BOOLEAN    IsNotificationServiceAvailable;
+  UINT16     FfaMmCommunicationPartId;
+  UINT16     FfaTestServicePartId;
+  UINT16     FfaTpm2ServicePartId;
+  UINT16     FfaNotificationServicePartId;
+  UINTN      SriIndex;
+} FFA_TEST_CONTEXT;
+
+#define FFA_BENCH_NAME_LENGTH   64
+#define FFA_BENCH_UNITS_LENGTH  8
+#define FFA_BENCH_MAX_RESULTS   64
+
+///
+/// Summary of one benchmark metric, as persisted to the results file.
+///
+typedef struct {
+  CHAR8     Name[FFA_BENCH_NAME_LENGTH];
+  CHAR8     Units[FFA_BENCH_UNITS_LENGTH];
+  UINTN     SampleCount;
+  UINT64    Min;
+  UINT64    P50;
+  UINT64    P90;
+  UINT64    P99;
+  UINT64    Max;
+  UINT64    Mean;
+} FFA_BENCH_RESULT;
+
+extern FFA_BENCH_RESULT  gFfaBenchResults[FFA_BENCH_MAX_RESULTS];
+extern UINTN             gFfaBenchResultCount;
+
+/**
+  Reads the current time in nanoseconds from the platform performance counter.
+
+  @retval The current time in nanoseconds.
+**/
+UINT64
+FfaBenchmarkGetTimeNs (
+  VOID
+  );
+
+/**
+  Sorts latency samples in ascending order.
+
+  @param[in, out] Samples      Array of latency samples.
+  @param[in]      SampleCount  Number of entries in Samples.
+**/
+VOID
+FfaBenchmarkSortSamples (
+  IN OUT UINT64  *Samples,
+  IN     UINTN   SampleCount
+  );
+
+/**
+  Returns the nearest-rank percentile of a sorted sample set.
+
+  @param[in] Sorted       Array of samples in ascending order.
+  @param[in] SampleCount  Number of entries in Sorted, must be non-zero.
+  @param[in] Percent      Percentile to compute, 0 - 100.
+
+  @retval The sample at the requested percentile.
+**/
+UINT64
+FfaBenchmarkPercentile (
+  IN CONST UINT64  *Sorted,
+  IN UINTN         SampleCount,
+  IN UINTN         Percent
+  );
+
+/**
+  Reports the latency distribution of a benchmark metric.
+
+  The samples are sorted in place and the summary is recorded in the result
+  table so it can be persisted after the suite completes.
+
+  @param[in]      Name         Name of the metric.
+  @param[in, out] Samples      Array of latency samples in nanoseconds.
+  @param[in]      SampleCount  Number of entries in Samples.
+**/
+VOID
+FfaBenchmarkReport (
+  IN     CONST CHAR8  *Name,
+  IN OUT UINT64       *Samples,
+  IN     UINTN        SampleCount
+  );
+
+/**
+  This routine benchmarks partition discovery through FFA_PARTITION_INFO_GET_REGS
+  against FFA_PARTITION_INFO_GET through the RX buffer.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfPartitionDiscovery (
+  IN UNIT_TEST_CONTEXT  Context
+  );
+
+/**
+  This routine checks reads of a PCR stay coherent with extends and resets
+  while the TPM service may answer them from its PCR shadow.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaMiscTestTpmPcrShadow (
+  IN UNIT_TEST_CONTEXT  Context
+  );
+
+/**
+  Helper prerequisite function to proceed with the soak test.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+CheckSoakEnabled (
+  IN UNIT_TEST_CONTEXT  Context
+  );
+
+/**
+  This routine runs mixed notification, test service and TPM traffic for the
+  configured soak duration and reports latency and SP heap trends.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfSoak (
+  IN UNIT_TEST_CONTEXT  Context
+  );
+
+/**
+  This routine writes all recorded benchmark results as JSON to the file system
+  the application was loaded from.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfSaveResults (
+  IN UNIT_TEST_CONTEXT  Context
+  );
+
+/**
+  This routine compares the recorded benchmark results against a baseline file
+  and fails if any metric regressed beyond the configured threshold.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FfaPerfCheckBaseline (
+  IN UNIT_TEST_CONTEXT  Context
+  );
+
+#endif // FFA_PARTITION_TEST_APP_H_
@@ -17,6 +17,18 @@
 #define NOTIFICATION_STATUS_INVALID_PARAMETER  (-2)
 #define NOTIFICATION_STATUS_NO_MEM             (-3)
 
+/*
+ * Version of the notification service interface, reported by NOTIFICATION_OPCODE_GET_VERSION.
+ *
+ * 1.1 decodes the opcode from Bits[0:2] of x9 (Arg5) instead of Bits[0:1]. Requests that set
+ * Bit[2] of x9 used to alias opcodes 0-3 and now select opcodes 4-7, so MEM_ASSIGN and
+ * MEM_UNASSIGN no longer alias ADD and REMOVE. Version 1.0 services do not implement
+ * GET_VERSION and decode it as UNREGISTER, which fails with NOTIFICATION_STATUS_INVALID_PARAMETER
+ * when x7-x8 (Arg3-Arg4) hold no registered service UUID.
+ */
+#define NOTIFICATION_SERVICE_MAJOR_VER  (0x1)
+#define NOTIFICATION_SERVICE_MINOR_VER  (0x1)
+
 #define NOTIFICATION_OPCODE_BASE          (0)
 #define NOTIFICATION_OPCODE_ADD           (NOTIFICATION_OPCODE_BASE + 0)
 #define NOTIFICATION_OPCODE_REMOVE        (NOTIFICATION_OPCODE_BASE + 1)
@@ -25,6 +37,23 @@
 #define NOTIFICATION_OPCODE_MEM_ASSIGN    (NOTIFICATION_OPCODE_BASE + 4)
 #define NOTIFICATION_OPCODE_MEM_UNASSIGN  (NOTIFICATION_OPCODE_BASE + 5)
 
+/*
+ * Removes every mapping owned by a source in a single request.
+ *
+ * Request:  x7-x8 (Arg3-Arg4) service UUID, all zero to remove the mappings of every service
+ *           x10 (Arg6) Bits[0:15] ID of the source whose mappings are removed, must be the
+ *           sender itself unless the sender is the hypervisor
+ * Response: x10 (Arg6) status, x11 (Arg7) number of mappings removed
+ */
+#define NOTIFICATION_OPCODE_UNREGISTER_SOURCE  (NOTIFICATION_OPCODE_BASE + 6)
+
+/*
+ * Reports the version of the notification service interface.
+ *
+ * Response: x10 (Arg6) status, x11 (Arg7) Bits[16:31] major version, Bits[0:15] minor version
+ */
+#define NOTIFICATION_OPCODE_GET_VERSION  (NOTIFICATION_OPCODE_BASE + 7)
+
 #pragma pack (1)
 typedef union {
   struct {
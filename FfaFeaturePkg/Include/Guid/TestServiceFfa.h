@@ -18,6 +18,31 @@
 
 #define TEST_OPCODE_BASE               (0xDEF0)
 #define TEST_OPCODE_TEST_NOTIFICATION  (TEST_OPCODE_BASE + 0x01)
+#define TEST_OPCODE_GET_TELEMETRY      (TEST_OPCODE_BASE + 0x02)
+#define TEST_OPCODE_BUSY_WAIT          (TEST_OPCODE_BASE + 0x03)
+
+/*
+ * TEST_OPCODE_BUSY_WAIT keeps the test service busy for x5 (Arg1) microseconds, at most
+ * TEST_BUSY_WAIT_MAX_US, so that callers can exercise long running requests.
+ */
+#define TEST_BUSY_WAIT_MAX_US  (1000000)
+
+/*
+ * TEST_OPCODE_GET_TELEMETRY response layout, x4 (i.e. Arg0) holds the status:
+ *   x5  (Arg1)  - Bytes held by live pool allocations
+ *   x6  (Arg2)  - Pool allocations since boot
+ *   x7  (Arg3)  - Pool frees since boot
+ *   x8  (Arg4)  - Failed pool/page allocations since boot
+ *   x9  (Arg5)  - Total heap pages
+ *   x10 (Arg6)  - Free heap pages
+ *   x11 (Arg7)  - Notification services in use
+ *   x12 (Arg8)  - Notification mappings in use
+ *   x13 (Arg9)  - Heap shrink events since boot
+ *   x14 (Arg10) - TPM PCR reads answered from the PCR shadow
+ *   x15 (Arg11) - TPM PCR reads forwarded to the TPM by the PCR shadow
+ *   x16 (Arg12) - TPM PCR shadow resyncs
+ *   x17 (Arg13) - TPM PCRs invalidated in the PCR shadow by extends
+ */
 
 extern EFI_GUID  gEfiTestServiceFfaGuid;
 
@@ -18,6 +18,41 @@ typedef ARM_SMC_ARGS ARM_SXC_ARGS;
 typedef ARM_SVC_ARGS ARM_SXC_ARGS;
 #endif
 
+/**
+ * Framework messages are sent through FFA_MSG_SEND_DIRECT_REQ with BIT31 of the
+ * flags in w2 (Arg0) set and the message type in Bits[0:7].
+ * VM availability messages carry the VM handle in w4 (Arg2) and the VM ID in w5 (Arg3).
+ */
+#define FFA_FRAMEWORK_MSG_BIT                BIT31
+#define FFA_FRAMEWORK_MSG_TYPE_MASK          0xFF
+#define FFA_FRAMEWORK_MSG_VM_CREATED_REQ     0x04
+#define FFA_FRAMEWORK_MSG_VM_CREATED_RESP    0x05
+#define FFA_FRAMEWORK_MSG_VM_DESTROYED_REQ   0x06
+#define FFA_FRAMEWORK_MSG_VM_DESTROYED_RESP  0x07
+
+/// Endpoint ID of the hypervisor, or of the normal world OS if there is none
+#define FFA_HYPERVISOR_ID  0x0000
+
+/**
+ * @brief Counters of the deadline bounded direct requests
+ */
+typedef struct {
+  /// Requests sent through FfaMessageSendDirectReq2Deadline
+  UINT64    Requests;
+
+  /// Requests that returned a response or an FF-A error
+  UINT64    Completed;
+
+  /// FFA_INTERRUPT and FFA_YIELD returns seen while waiting for a response
+  UINT64    Interrupts;
+
+  /// Requests abandoned because their deadline expired
+  UINT64    Timeouts;
+
+  /// Abandoned requests resumed through FfaMessageResumeDirectReq2
+  UINT64    Resumes;
+} FFA_DIRECT_REQ_DEADLINE_STATISTICS;
+
 /**
  * @brief Direct message type
  */
@@ -144,6 +179,78 @@ FfaMessageSendDirectReq2 (
   IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs
   );
 
+/**
+ * @brief      Sends a partition message in parameter registers as a request
+ *             and blocks until the response is available or the deadline
+ *             expires.
+ * @note       Deadlines are only supported for normal world callers. The
+ *             deadline is checked every time FFA_INTERRUPT or FFA_YIELD hands
+ *             control back before the response. Before the deadline the
+ *             preempted endpoint is run again with FFA_RUN, once it has expired
+ *             the request is abandoned instead. The destination keeps
+ *             processing it and must be resumed with FfaMessageResumeDirectReq2
+ *             before another deadline bounded request can be sent. A secure
+ *             partition handles its own interrupts and waits them out with
+ *             FFA_MSG_WAIT, it can only pass MAX_UINT64.
+ * @note       The elapsed time is measured with TimerLib, which must be backed
+ *             by a running performance counter. With BaseTimerLibNullTemplate
+ *             only MAX_UINT64 can be used.
+ *
+ * @param[in]     DestPartId   Destination endpoint ID
+ * @param[in]     ServiceGuid  Service GUID, NULL for the null UUID
+ * @param[in,out] ImpDefArgs   The request message on input, the response on output
+ * @param[in]     TimeoutNs    Time in nanoseconds the request may run before it is abandoned,
+ *                             MAX_UINT64 for no deadline
+ *
+ * @retval EFI_SUCCESS      The response is in ImpDefArgs
+ * @retval EFI_TIMEOUT      The deadline expired, the request was abandoned
+ * @retval EFI_NOT_READY    An abandoned request has not been resumed yet
+ * @retval EFI_UNSUPPORTED  A deadline was given by a secure partition or the performance
+ *                          counter is not running
+ * @retval Others           The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaMessageSendDirectReq2Deadline (
+  IN      UINT16              DestPartId,
+  IN      EFI_GUID            *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  IN      UINT64              TimeoutNs
+  );
+
+/**
+ * @brief      Resumes the request abandoned by FfaMessageSendDirectReq2Deadline
+ *             and blocks until the response is available or the new deadline
+ *             expires.
+ *
+ * @param[out] ImpDefArgs  The response message
+ * @param[in]  TimeoutNs   Time in nanoseconds the request may run before it is abandoned again,
+ *                         MAX_UINT64 for no deadline
+ *
+ * @retval EFI_SUCCESS      The response is in ImpDefArgs
+ * @retval EFI_TIMEOUT      The deadline expired again, the request is still abandoned
+ * @retval EFI_NOT_FOUND    No request was abandoned
+ * @retval EFI_UNSUPPORTED  A deadline was given but the performance counter is not running
+ * @retval Others           The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaMessageResumeDirectReq2 (
+  OUT DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  IN  UINT64              TimeoutNs
+  );
+
+/**
+ * @brief      Retrieves the counters of the deadline bounded direct requests.
+ *
+ * @param[out] Statistics  Returns the counters
+ */
+VOID
+EFIAPI
+FfaDirectReqDeadlineGetStatistics (
+  OUT FFA_DIRECT_REQ_DEADLINE_STATISTICS  *Statistics
+  );
+
 /**
  * @brief      Sends a 32 bit partition message in parameter registers as a
  *             response and blocks until the response is available.
@@ -226,6 +333,35 @@ FfaPartitionInfoGetRegs (
   OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
   );
 
+/**
+ * @brief      Retrieves partition descriptors through FFA_PARTITION_INFO_GET_REGS
+ *             along with the index of the last descriptor available.
+ * @note       A sweep starts at index 0 with a tag of 0 and continues from the
+ *             index after the last one returned, passing back the returned tag,
+ *             until that index passes LastIndex. The call fails with
+ *             EFI_NOT_READY if the partition information changed since the tag
+ *             was issued, the sweep must then start over.
+ *
+ * @param[in]     ServiceGuid    Service to look up, NULL for all partitions
+ * @param[in]     StartIndex     Index of the first descriptor to return
+ * @param[in,out] Tag            UUID information tag of the sweep
+ * @param[out]    LastIndex      Index of the last descriptor available
+ * @param[in,out] PartDescCount  Capacity of PartDesc on input, descriptors returned on output
+ * @param[out]    PartDesc       The partition descriptors
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaPartitionInfoGetRegsEx (
+  IN EFI_GUID                 *ServiceGuid,
+  IN UINT16                   StartIndex,
+  IN OUT UINT16               *Tag OPTIONAL,
+  OUT UINT16                  *LastIndex OPTIONAL,
+  IN OUT UINT32               *PartDescCount,
+  OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
+  );
+
 EFI_STATUS
 EFIAPI
 FfaNotificationBitmapCreate (
@@ -47,6 +47,28 @@ NotificationServiceHandle (
   DIRECT_MSG_ARGS_EX  *Response
   );
 
+/**
+  Handler for FF-A framework messages
+
+  Removes every mapping owned by a VM once the hypervisor reports it destroyed,
+  so a VM that went away without unregistering does not leak its mappings.
+  Partitions subscribed to VM availability messages call this from their
+  message loop on every direct request, before routing it to a service by
+  UUID, see Docs/PartitionGuide.md.
+
+  @param  Request   The incoming message
+  @param  Response  The outgoing message, complete with its function and endpoint IDs
+
+  @retval TRUE   Request was a framework message handled here, send Response back
+  @retval FALSE  Request is not a framework message handled by this service
+
+**/
+BOOLEAN
+NotificationServiceHandleFrameworkMessage (
+  DIRECT_MSG_ARGS_EX  *Request,
+  DIRECT_MSG_ARGS_EX  *Response
+  );
+
 /**
   Calls NotificationSet on the given ID with the given flag
 
@@ -80,4 +102,17 @@ NotificationServiceExtractUuid (
   UINT8   *Uuid
   );
 
+/**
+  Reports how much of the notification tables is in use
+
+  @param  ServiceCount  The number of service slots in use
+  @param  MappingCount  The number of registered cookie/ID mappings across all services
+
+**/
+VOID
+NotificationServiceGetUsage (
+  UINT32  *ServiceCount,
+  UINT32  *MappingCount
+  );
+
 #endif /* NOTIFICATION_SERVICE_LIB_H_ */
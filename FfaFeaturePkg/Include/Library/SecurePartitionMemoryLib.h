@@ -0,0 +1,116 @@
+/** @file
+  Provides introspection and memory pressure handling of the secure partition
+  heap managed by SecurePartitionMemoryAllocationLib.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef SECURE_PARTITION_MEMORY_LIB_H_
+#define SECURE_PARTITION_MEMORY_LIB_H_
+
+#include <Base.h>
+
+typedef struct {
+  /// Number of successful pool allocations since boot
+  UINT64    PoolAllocations;
+  /// Number of pool frees since boot
+  UINT64    PoolFrees;
+  /// Bytes currently held by live pool allocations, including pool headers
+  UINT64    PoolBytesInUse;
+  /// Number of pool or page allocations that failed since boot
+  UINT64    FailedAllocations;
+  /// Pages handed to the allocator from the heap regions
+  UINT64    TotalPages;
+  /// Pages currently on the free page list
+  UINT64    FreePages;
+  /// Number of times the registered shrinkers were asked to release memory
+  UINT64    ShrinkEvents;
+  /// Pages the shrinkers reported as released
+  UINT64    ShrinkPagesReleased;
+  /// Allocations that only succeeded after the shrinkers released memory
+  UINT64    ShrinkRecoveredAllocations;
+} SP_MEMORY_STATISTICS;
+
+/**
+  Asks a cache to release memory back to the secure partition heap.
+
+  Shrinkers run when an allocation is about to fail or when the free pages drop
+  below PcdSpMemoryLowWaterPages. They may free memory but must not rely on
+  allocating any.
+
+  @param  Context      The context passed to SpMemoryRegisterShrinker
+  @param  PagesWanted  The number of pages the allocator is trying to recover
+
+  @retval The number of pages released, an estimate is sufficient
+
+**/
+typedef
+UINTN
+(EFIAPI *SP_MEMORY_SHRINKER)(
+  IN VOID   *Context,
+  IN UINTN  PagesWanted
+  );
+
+/**
+  Retrieves the current heap statistics of the secure partition.
+
+  @param  Statistics  Receives the heap statistics
+
+  @retval EFI_SUCCESS            The statistics were retrieved
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL
+
+**/
+EFI_STATUS
+EFIAPI
+SpMemoryGetStatistics (
+  OUT SP_MEMORY_STATISTICS  *Statistics
+  );
+
+/**
+  Registers a shrinker that is asked to release memory under memory pressure.
+
+  Shrinkers are called in ascending Priority order until enough pages were
+  released, so caches that are cheapest to rebuild should use lower values.
+
+  @param  Shrinker  The function releasing memory
+  @param  Context   The context passed to Shrinker
+  @param  Priority  The order Shrinker is called in, lower values are called first
+
+  @retval EFI_SUCCESS            The shrinker was registered
+  @retval EFI_INVALID_PARAMETER  Shrinker is NULL
+  @retval EFI_ALREADY_STARTED    Shrinker is already registered with Context
+  @retval EFI_OUT_OF_RESOURCES   The shrinker table is full
+  @retval EFI_NOT_READY          The shrinkers are running, the table cannot change order
+
+**/
+EFI_STATUS
+EFIAPI
+SpMemoryRegisterShrinker (
+  IN SP_MEMORY_SHRINKER  Shrinker,
+  IN VOID                *Context OPTIONAL,
+  IN UINT32              Priority
+  );
+
+/**
+  Unregisters a shrinker registered by SpMemoryRegisterShrinker.
+
+  A shrinker may unregister itself or another shrinker while it runs, the
+  entry is then removed once all shrinkers returned.
+
+  @param  Shrinker  The function releasing memory
+  @param  Context   The context Shrinker was registered with
+
+  @retval EFI_SUCCESS    The shrinker was unregistered
+  @retval EFI_NOT_FOUND  Shrinker is not registered with Context
+
+**/
+EFI_STATUS
+EFIAPI
+SpMemoryUnregisterShrinker (
+  IN SP_MEMORY_SHRINKER  Shrinker,
+  IN VOID                *Context OPTIONAL
+  );
+
+#endif /* SECURE_PARTITION_MEMORY_LIB_H_ */
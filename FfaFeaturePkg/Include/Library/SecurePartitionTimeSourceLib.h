@@ -0,0 +1,70 @@
+/** @file
+  Provides information on the time source backing TimerLib in a secure partition.
+
+  Depending on the SPMC configuration the generic timer counter may not be
+  accessible from a secure partition. ArmArchTimerLibEx probes the time sources
+  permitted by PcdSpTimeSources on first use and routes GetPerformanceCounter ()
+  through the best one available, falling back to the generic timer counter
+  when none is usable. This library reports which source was picked
+  so instrumentation can judge how far its timestamps can be trusted.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef SECURE_PARTITION_TIME_SOURCE_LIB_H_
+#define SECURE_PARTITION_TIME_SOURCE_LIB_H_
+
+#include <Base.h>
+
+///
+/// Bits of PcdSpTimeSources enabling each time source.
+///
+#define SP_TIME_SOURCE_GENERIC_COUNTER  BIT0
+#define SP_TIME_SOURCE_COUNTER_FRAME    BIT1
+#define SP_TIME_SOURCE_PMU_CYCLES       BIT2
+
+typedef enum {
+  /// No usable time source, the performance counter does not advance
+  SpTimeSourceNone,
+  /// Generic timer counter read through the system registers from EL0
+  SpTimeSourceGenericCounter,
+  /// Memory-mapped generic timer counter frame mapped by the SPMC
+  SpTimeSourceCounterFrame,
+  /// PMU cycle counter, only constant-rate if the CPU clock is fixed
+  SpTimeSourcePmuCycles
+} SP_TIME_SOURCE_TYPE;
+
+typedef struct {
+  /// The selected time source
+  SP_TIME_SOURCE_TYPE    Type;
+  /// Frequency of the time source in Hz, 0 if no source is available
+  UINT64                 Frequency;
+  /// Duration of a single tick in nanoseconds, rounded up
+  UINT64                 ResolutionNs;
+  /// Average cost of reading the time source in nanoseconds, measured while probing
+  UINT64                 ReadCostNs;
+} SP_TIME_SOURCE_INFO;
+
+/**
+  Retrieves the time source backing the performance counter.
+
+  The time sources are probed on the first call to this function or to any
+  TimerLib function.
+
+  @param  Info  Returns the selected time source and its properties
+
+  @retval RETURN_SUCCESS            Info describes a usable time source
+  @retval RETURN_INVALID_PARAMETER  Info is NULL
+  @retval RETURN_UNSUPPORTED        None of the enabled time sources is usable, Info
+                                    describes SpTimeSourceNone
+
+**/
+RETURN_STATUS
+EFIAPI
+SpTimeSourceGetInfo (
+  OUT SP_TIME_SOURCE_INFO  *Info
+  );
+
+#endif // SECURE_PARTITION_TIME_SOURCE_LIB_H_
@@ -14,6 +14,18 @@
 #include <Library/ArmSvcLib.h>
 #include <Library/ArmFfaLibEx.h>
 
+/* Counters of the PCR shadow, enabled by PcdTpmServicePcrShadow */
+typedef struct {
+  /* TPM2_PCR_Read commands answered from the shadow */
+  UINT64    Hits;
+  /* TPM2_PCR_Read commands forwarded to the TPM */
+  UINT64    Misses;
+  /* PCRs invalidated by extend commands */
+  UINT64    Invalidations;
+  /* Times the whole shadow was discarded */
+  UINT64    Resyncs;
+} TPM_PCR_SHADOW_STATISTICS;
+
 /**
   Initializes the TPM service
 
@@ -45,4 +57,18 @@ TpmServiceHandle (
   DIRECT_MSG_ARGS_EX  *Response
   );
 
+/**
+  Retrieves the counters of the PCR shadow
+
+  @param  Statistics  Returns the PCR shadow counters
+
+  @retval EFI_SUCCESS            Statistics holds the counters
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL
+
+**/
+EFI_STATUS
+TpmServiceGetPcrShadowStatistics (
+  TPM_PCR_SHADOW_STATISTICS  *Statistics
+  );
+
 #endif /* TPM_SERVICE_LIB_H_ */
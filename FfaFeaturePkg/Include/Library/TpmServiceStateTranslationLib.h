@@ -46,6 +46,11 @@ TpmSstCmdReady (
 /**
   Initiates command execution
 
+  The client may cancel the command by setting the cancel bit in the internal CRB,
+  either together with Start or while the service yields waiting on the TPM. The
+  cancel is propagated to the TPM and the command completes with the response of
+  the TPM, or with TPM_RC_CANCELED if the TPM discarded it.
+
   @param  Locality        The locality of the TPM to initiate the command on
   @param  InternalTpmCrb  The internal CRB to copy command data from
 
@@ -59,6 +64,31 @@ TpmSstStart (
   PTP_CRB_REGISTERS_PTR  InternalTpmCrb
   );
 
+/**
+  Initiates execution of a command already copied out of the internal CRB
+
+  Behaves as TpmSstStart, but the command is taken from a buffer private to the
+  secure partition so the client cannot change it while it is inspected or sent.
+
+  @param  Locality          The locality of the TPM to initiate the command on
+  @param  InternalTpmCrb    The internal CRB the response is copied to
+  @param  TpmCommandBuffer  The command on input, the response on output, sized as the CRB data buffer
+  @param  CommandDataLen    The size of the command in TpmCommandBuffer
+  @param  ResponseDataLen   The size of the response the client accepts
+
+  @retval EFI_SUCCESS  Success
+  @retval EFI_TIMEOUT  Timeout
+
+**/
+EFI_STATUS
+TpmSstStartBuffer (
+  UINT8                  Locality,
+  PTP_CRB_REGISTERS_PTR  InternalTpmCrb,
+  UINT8                  *TpmCommandBuffer,
+  UINT32                 CommandDataLen,
+  UINT32                 ResponseDataLen
+  );
+
 /**
   Requests access to the given locality
 
@@ -1,6 +1,19 @@
 /** @file
   Generic ARM implementation of TimerLib.h
 
+  The generic timer counter cannot be relied on in every secure partition
+  configuration, so the performance counter is backed by the best time source
+  found among those enabled by PcdSpTimeSources:
+
+    - the generic timer counter read from EL0,
+    - a memory-mapped generic timer counter frame mapped by the SPMC,
+    - the PMU cycle counter, if EL0 access was granted.
+
+  The sources are probed on first use. Sources that are not enabled are never
+  touched, as reading an inaccessible counter traps. Without a usable source
+  the performance counter falls back to the generic timer counter, as the
+  baseline ArmArchTimerLib does, while MicroSecondDelay () stays a busy loop.
+
   Copyright (c) 2011 - 2021, Arm Limited. All rights reserved.<BR>
 
   SPDX-License-Identifier: BSD-2-Clause-Patent
@@ -10,38 +23,352 @@
 #include <Base.h>
 #include <Library/ArmLib.h>
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/TimerLib.h>
 #include <Library/DebugLib.h>
+#include <Library/IoLib.h>
 #include <Library/PcdLib.h>
 #include <Library/ArmGenericTimerCounterLib.h>
+#include <Library/SecurePartitionTimeSourceLib.h>
+
+// Register offsets in a CNTBaseN counter frame
+#define CNTBASE_CNTPCT  0x000
+#define CNTBASE_CNTFRQ  0x010
+
+// PMUSERENR_EL0 bits granting EL0 access to the cycle counter
+#define PMUSERENR_EN  BIT0
+#define PMUSERENR_CR  BIT2
+
+// Reads waiting for a probed time source to advance before it is considered stopped
+#define TIME_SOURCE_PROBE_ATTEMPTS  1000
 
-#define TICKS_PER_MICRO_SEC  (ArmGenericTimerGetTimerFreq ()/1000000U)
+// Back to back reads averaged to measure the read cost of a time source
+#define TIME_SOURCE_COST_READS  32
+
+STATIC BOOLEAN              mTimeSourceProbed;
+STATIC SP_TIME_SOURCE_INFO  mTimeSource;
 
 /**
-  A local utility function that returns the PCD value, if specified.
-  Otherwise it defaults to ArmGenericTimerGetTimerFreq.
+  Reads PMUSERENR_EL0.
 
-  @return The timer frequency.
+  @return The value of PMUSERENR_EL0.
 
 **/
-STATIC
-UINTN
+UINT64
 EFIAPI
-GetPlatformTimerFreq (
+ArmReadPmuUserEnable (
+  VOID
+  );
+
+/**
+  Reads the PMU cycle counter PMCCNTR_EL0.
+
+  @return The value of PMCCNTR_EL0.
+
+**/
+UINT64
+EFIAPI
+ArmReadPmuCycleCounter (
+  VOID
+  );
+
+/**
+  Converts ticks of a time source to nanoseconds.
+
+  @param  Ticks      The number of ticks.
+  @param  Frequency  The frequency of the time source in Hz.
+
+  @return The time in nanoseconds.
+
+**/
+STATIC
+UINT64
+TicksToNanoSeconds (
+  IN UINT64  Ticks,
+  IN UINT64  Frequency
+  )
+{
+  UINT64  NanoSeconds;
+  UINT64  Remainder;
+
+  //
+  //          Ticks
+  // Time = --------- x 1,000,000,000
+  //        Frequency
+  //
+  NanoSeconds = MultU64x64 (
+                  DivU64x64Remainder (
+                    Ticks,
+                    Frequency,
+                    &Remainder
+                    ),
+                  1000000000U
+                  );
+
+  //
+  // Frequency < 0x100000000, so Remainder < 0x100000000, then (Remainder * 1,000,000,000)
+  // will not overflow 64-bit.
+  //
+  NanoSeconds += DivU64x64Remainder (
+                   MultU64x64 (
+                     Remainder,
+                     1000000000U
+                     ),
+                   Frequency,
+                   NULL
+                   );
+
+  return NanoSeconds;
+}
+
+/**
+  Reads the current value of a time source.
+
+  @param  Type  The time source to read.
+
+  @return The current tick count, 0 for SpTimeSourceNone.
+
+**/
+STATIC
+UINT64
+ReadTimeSource (
+  IN SP_TIME_SOURCE_TYPE  Type
+  )
+{
+  switch (Type) {
+    case SpTimeSourceGenericCounter:
+      return ArmGenericTimerGetSystemCount ();
+    case SpTimeSourceCounterFrame:
+      return MmioRead64 ((UINTN)FixedPcdGet64 (PcdSpTimeCounterFrameBase) + CNTBASE_CNTPCT);
+ #ifdef MDE_CPU_AARCH64
+    case SpTimeSourcePmuCycles:
+      return ArmReadPmuCycleCounter ();
+ #endif
+    default:
+      return 0;
+  }
+}
+
+/**
+  Returns the frequency of a time source if it is enabled and accessible.
+
+  @param  Type  The time source to check.
+
+  @return The frequency in Hz, 0 if the time source cannot be used.
+
+**/
+STATIC
+UINT64
+GetTimeSourceFrequency (
+  IN SP_TIME_SOURCE_TYPE  Type
+  )
+{
+  UINT32  Enabled;
+
+  Enabled = FixedPcdGet32 (PcdSpTimeSources);
+
+  switch (Type) {
+    case SpTimeSourceGenericCounter:
+      if ((Enabled & SP_TIME_SOURCE_GENERIC_COUNTER) == 0) {
+        return 0;
+      }
+
+      return ArmGenericTimerGetTimerFreq ();
+    case SpTimeSourceCounterFrame:
+      if (((Enabled & SP_TIME_SOURCE_COUNTER_FRAME) == 0) || (FixedPcdGet64 (PcdSpTimeCounterFrameBase) == 0)) {
+        return 0;
+      }
+
+      return MmioRead32 ((UINTN)FixedPcdGet64 (PcdSpTimeCounterFrameBase) + CNTBASE_CNTFRQ);
+ #ifdef MDE_CPU_AARCH64
+    case SpTimeSourcePmuCycles:
+      if ((Enabled & SP_TIME_SOURCE_PMU_CYCLES) == 0) {
+        return 0;
+      }
+
+      // PMUSERENR_EL0 is readable from EL0, the cycle counter only if it grants access
+      if ((ArmReadPmuUserEnable () & (PMUSERENR_EN | PMUSERENR_CR)) == 0) {
+        return 0;
+      }
+
+      return FixedPcdGet64 (PcdSpTimePmuFrequency);
+ #endif
+    default:
+      return 0;
+  }
+}
+
+/**
+  Checks that a time source is running and measures its properties.
+
+  @param  Type  The time source to probe.
+  @param  Info  Returns the properties of the time source.
+
+  @retval TRUE   The time source is usable and Info was filled in.
+  @retval FALSE  The time source is disabled, inaccessible or stopped.
+
+**/
+STATIC
+BOOLEAN
+ProbeTimeSource (
+  IN  SP_TIME_SOURCE_TYPE  Type,
+  OUT SP_TIME_SOURCE_INFO  *Info
   )
 {
-  UINTN  TimerFreq;
+  UINT64  Frequency;
+  UINT64  Start;
+  UINT64  End;
+  UINTN   Index;
+
+  Frequency = GetTimeSourceFrequency (Type);
+  if (Frequency == 0) {
+    return FALSE;
+  }
+
+  // A counter that was never enabled reads as a constant
+  Start = ReadTimeSource (Type);
+  for (Index = 0; Index < TIME_SOURCE_PROBE_ATTEMPTS; Index++) {
+    if (ReadTimeSource (Type) != Start) {
+      break;
+    }
+  }
+
+  if (Index == TIME_SOURCE_PROBE_ATTEMPTS) {
+    DEBUG ((DEBUG_WARN, "%a: Time source %d is not advancing\n", __func__, Type));
+    return FALSE;
+  }
+
+  Start = ReadTimeSource (Type);
+  for (Index = 0; Index < TIME_SOURCE_COST_READS; Index++) {
+    ReadTimeSource (Type);
+  }
+
+  End = ReadTimeSource (Type);
+
+  Info->Type         = Type;
+  Info->Frequency    = Frequency;
+  Info->ResolutionNs = MAX (DivU64x64Remainder (1000000000U + Frequency - 1, Frequency, NULL), 1);
+  Info->ReadCostNs   = DivU64x32 (TicksToNanoSeconds (End - Start, Frequency), TIME_SOURCE_COST_READS + 1);
+  return TRUE;
+}
+
+/**
+  Returns the time source backing the performance counter, probing the enabled
+  time sources on first use.
+
+  Constant-rate counters are preferred, the cheaper one to read wins. A read
+  cost that rounds to 0 ns was not measured and never wins over the source
+  found first. The PMU cycle counter follows the CPU clock and is only used
+  when neither counter is usable.
+
+  @return The selected time source.
+
+**/
+STATIC
+CONST SP_TIME_SOURCE_INFO *
+GetTimeSource (
+  VOID
+  )
+{
+  SP_TIME_SOURCE_INFO  Candidate;
+  UINT32               Type;
+
+  if (mTimeSourceProbed) {
+    return &mTimeSource;
+  }
+
+  // Calls made while probing see SpTimeSourceNone
+  mTimeSourceProbed = TRUE;
+
+  for (Type = SpTimeSourceGenericCounter; Type <= SpTimeSourcePmuCycles; Type++) {
+    if (!ProbeTimeSource ((SP_TIME_SOURCE_TYPE)Type, &Candidate)) {
+      continue;
+    }
+
+    if ((mTimeSource.Type == SpTimeSourceNone) ||
+        ((Candidate.Type != SpTimeSourcePmuCycles) && (Candidate.ReadCostNs != 0) &&
+         (Candidate.ReadCostNs < mTimeSource.ReadCostNs)))
+    {
+      CopyMem (&mTimeSource, &Candidate, sizeof (SP_TIME_SOURCE_INFO));
+    }
+  }
+
+  if (mTimeSource.Type == SpTimeSourceNone) {
+    DEBUG ((DEBUG_WARN, "%a: No usable time source, performance counter falls back to the generic timer\n", __func__));
+  } else {
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: Time source %d, %ld Hz, resolution %ld ns, read cost %ld ns\n",
+      __func__,
+      mTimeSource.Type,
+      mTimeSource.Frequency,
+      mTimeSource.ResolutionNs,
+      mTimeSource.ReadCostNs
+      ));
+  }
+
+  return &mTimeSource;
+}
+
+/**
+  Returns the frequency of the performance counter.
+
+  @return The frequency of the selected time source, or of the generic timer
+          counter if no time source is usable.
+
+**/
+STATIC
+UINT64
+GetPerformanceCounterFrequency (
+  VOID
+  )
+{
+  UINT64  Frequency;
+
+  Frequency = GetTimeSource ()->Frequency;
+  if (Frequency == 0) {
+    Frequency = ArmGenericTimerGetTimerFreq ();
+  }
+
+  // Callers divide by the frequency, CNTFRQ must be programmed by the firmware
+  ASSERT (Frequency != 0);
+  return Frequency;
+}
+
+/**
+  Retrieves the time source backing the performance counter.
+
+  The time sources are probed on the first call to this function or to any
+  TimerLib function.
+
+  @param  Info  Returns the selected time source and its properties
 
-  TimerFreq = ArmGenericTimerGetTimerFreq ();
+  @retval RETURN_SUCCESS            Info describes a usable time source
+  @retval RETURN_INVALID_PARAMETER  Info is NULL
+  @retval RETURN_UNSUPPORTED        None of the enabled time sources is usable, Info
+                                    describes SpTimeSourceNone
 
-  ASSERT (TimerFreq != 0);
+**/
+RETURN_STATUS
+EFIAPI
+SpTimeSourceGetInfo (
+  OUT SP_TIME_SOURCE_INFO  *Info
+  )
+{
+  if (Info == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
 
-  return TimerFreq;
+  CopyMem (Info, GetTimeSource (), sizeof (SP_TIME_SOURCE_INFO));
+  return (Info->Type == SpTimeSourceNone) ? RETURN_UNSUPPORTED : RETURN_SUCCESS;
 }
 
 /**
   Stalls the CPU for the number of microseconds specified by MicroSeconds.
 
+  Without an enabled time source the delay is a busy loop that never reads a
+  counter.
+
   @param  MicroSeconds  The minimum number of microseconds to delay.
 
   @return The value of MicroSeconds input.
@@ -53,43 +380,56 @@ MicroSecondDelay (
   IN      UINTN  MicroSeconds
   )
 {
-  UINT64  TimerTicks64;
-  UINT64  SystemCounterVal;
+  CONST SP_TIME_SOURCE_INFO  *TimeSource;
+  UINT64                     TimerTicks64;
+  UINT64                     SystemCounterVal;
+  UINT64                     PreviousSystemCounterVal;
+  UINT64                     DeltaCounterVal;
+
+  TimeSource = GetTimeSource ();
+
+  if (TimeSource->Type == SpTimeSourceNone) {
+    // MU_CHANGE - Start - Cannot depend on GenericTimer Calls
+    TimerTicks64 = DivU64x32 (
+                     MultU64x64 (
+                       MicroSeconds,
+                       ArmGenericTimerGetTimerFreq ()
+                       ),
+                     1000000U
+                     );
+
+    // Wait until delay count expires.
+    SystemCounterVal = 0;
+    while (SystemCounterVal < TimerTicks64) {
+      SystemCounterVal++;
+    }
 
-  // MU_CHANGE - Start - Cannot depend on GenericTimer Calls
-  //  UINT64  PreviousSystemCounterVal;
-  //  UINT64  DeltaCounterVal;
-  // MU_CHANGE - End - Cannot depend on GenericTimer Calls
+    // MU_CHANGE - End - Cannot depend on GenericTimer Calls
+    return MicroSeconds;
+  }
 
   // Calculate counter ticks that represent requested delay:
-  //  = MicroSeconds x TICKS_PER_MICRO_SEC
   //  = MicroSeconds x Frequency.10^-6
   TimerTicks64 = DivU64x32 (
                    MultU64x64 (
                      MicroSeconds,
-                     GetPlatformTimerFreq ()
+                     TimeSource->Frequency
                      ),
                    1000000U
                    );
 
-  // MU_CHANGE - Start - Cannot depend on GenericTimer Calls
-  //  // Read System Counter value
-  //  PreviousSystemCounterVal = ArmGenericTimerGetSystemCount ();
-  //
-  //  // Wait until delay count expires.
-  //  while (TimerTicks64 > 0) {
-  //    SystemCounterVal = ArmGenericTimerGetSystemCount ();
-  //    // Get how much we advanced this tick. Wrap around still has delta correct
-  //    DeltaCounterVal = (SystemCounterVal - PreviousSystemCounterVal)
-  //                      & (MAX_UINT64 >> 8); // Account for a lesser (minimum) size
-  //    // Never wrap back around below zero by choosing the min and thus stop at 0
-  //    TimerTicks64            -= MIN (TimerTicks64, DeltaCounterVal);
-  //    PreviousSystemCounterVal = SystemCounterVal;
+  // Read System Counter value
+  PreviousSystemCounterVal = ReadTimeSource (TimeSource->Type);
+
   // Wait until delay count expires.
-  SystemCounterVal = 0;
-  while (SystemCounterVal < TimerTicks64) {
-    SystemCounterVal++;
-    // MU_CHANGE - End - Cannot depend on GenericTimer Calls
+  while (TimerTicks64 > 0) {
+    SystemCounterVal = ReadTimeSource (TimeSource->Type);
+    // Get how much we advanced this tick. Wrap around still has delta correct
+    DeltaCounterVal = (SystemCounterVal - PreviousSystemCounterVal)
+                      & (MAX_UINT64 >> 8); // Account for a lesser (minimum) size
+    // Never wrap back around below zero by choosing the min and thus stop at 0
+    TimerTicks64            -= MIN (TimerTicks64, DeltaCounterVal);
+    PreviousSystemCounterVal = SystemCounterVal;
   }
 
   return MicroSeconds;
@@ -142,8 +482,14 @@ GetPerformanceCounter (
   VOID
   )
 {
-  // Just return the value of system count
-  return ArmGenericTimerGetSystemCount ();
+  CONST SP_TIME_SOURCE_INFO  *TimeSource;
+
+  TimeSource = GetTimeSource ();
+  if (TimeSource->Type == SpTimeSourceNone) {
+    return ArmGenericTimerGetSystemCount ();
+  }
+
+  return ReadTimeSource (TimeSource->Type);
 }
 
 /**
@@ -186,7 +532,7 @@ GetPerformanceCounterProperties (
     *EndValue = 0xFFFFFFFFFFFFFFFFUL;
   }
 
-  return (UINT64)ArmGenericTimerGetTimerFreq ();
+  return GetPerformanceCounterFrequency ();
 }
 
 /**
@@ -206,37 +552,12 @@ GetTimeInNanoSecond (
   IN      UINT64  Ticks
   )
 {
-  UINT64  NanoSeconds;
-  UINT64  Remainder;
   UINT64  TimerFreq;
 
-  TimerFreq = GetPlatformTimerFreq ();
-  //
-  //          Ticks
-  // Time = --------- x 1,000,000,000
-  //        Frequency
-  //
-  NanoSeconds = MultU64x64 (
-                  DivU64x64Remainder (
-                    Ticks,
-                    TimerFreq,
-                    &Remainder
-                    ),
-                  1000000000U
-                  );
-
-  //
-  // Frequency < 0x100000000, so Remainder < 0x100000000, then (Remainder * 1,000,000,000)
-  // will not overflow 64-bit.
-  //
-  NanoSeconds += DivU64x64Remainder (
-                   MultU64x64 (
-                     Remainder,
-                     1000000000U
-                     ),
-                   TimerFreq,
-                   NULL
-                   );
+  TimerFreq = GetPerformanceCounterFrequency ();
+  if (TimerFreq == 0) {
+    return 0;
+  }
 
-  return NanoSeconds;
+  return TicksToNanoSeconds (Ticks, TimerFreq);
 }
@@ -16,11 +16,32 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/ArmFfaLibEx.h>
 #include <Library/PlatformFfaInterruptLib.h>
+#include <Library/TimerLib.h>
 
 #define INVALID_SOURCE_ID  0xFFFF
 
+#ifndef ARM_FID_FFA_YIELD
+#define ARM_FID_FFA_YIELD  0x8400006C
+#endif
+
+#ifndef ARM_FID_FFA_RUN
+#define ARM_FID_FFA_RUN  0x8400006D
+#endif
+
+/* Bit[15] of an endpoint ID is set for secure partitions */
+#define FFA_SECURE_ENDPOINT_ID_BIT  BIT15
+
 STATIC UINT16  mPartitionId = INVALID_SOURCE_ID;
 
+/*
+ * Deadline bounded direct request abandoned on expiry, waiting to be resumed. New requests
+ * are refused until it is, so only the same request can be abandoned again once resumed.
+ */
+STATIC BOOLEAN                             mAbandonedRequest;
+STATIC UINT16                              mAbandonedDestPartId;
+STATIC UINTN                               mAbandonedTargetInfo;
+STATIC FFA_DIRECT_REQ_DEADLINE_STATISTICS  mDeadlineStats;
+
 /**
   This function is used to prepare a GUID for FF-A.
 
@@ -269,6 +290,206 @@ FfaMessageSendDirectReq2 (
   return EFI_SUCCESS;
 }
 
+/*
+ * Runs the preempted destination of a direct request again through FFA_RUN.
+ */
+STATIC
+VOID
+FfaRunDirectReq (
+  IN  UINTN         TargetInfo,
+  OUT ARM_SXC_ARGS  *Result
+  )
+{
+  ARM_SXC_ARGS  Request = { 0 };
+
+  Request.Arg0 = ARM_FID_FFA_RUN;
+  Request.Arg1 = TargetInfo;
+  ArmCallSxc (&Request, Result);
+}
+
+/*
+ * Returns the nanoseconds elapsed since the performance counter read Start, following
+ * the counting direction and roll over reported by GetPerformanceCounterProperties.
+ */
+STATIC
+UINT64
+FfaElapsedNs (
+  IN  UINT64  Start
+  )
+{
+  UINT64  Now;
+  UINT64  StartValue;
+  UINT64  EndValue;
+  UINT64  Ticks;
+
+  Now = GetPerformanceCounter ();
+  GetPerformanceCounterProperties (&StartValue, &EndValue);
+  if (EndValue >= StartValue) {
+    Ticks = (Now >= Start) ? (Now - Start) : ((EndValue - Start) + (Now - StartValue) + 1);
+  } else {
+    Ticks = (Start >= Now) ? (Start - Now) : ((Start - EndValue) + (StartValue - Now) + 1);
+  }
+
+  return GetTimeInNanoSecond (Ticks);
+}
+
+/*
+ * Returns TRUE if this endpoint is a secure partition, which waits out its own interrupts
+ * with FFA_MSG_WAIT. Normal world endpoints get control back on every FFA_INTERRUPT and
+ * FFA_YIELD of the request and run the preempted endpoint again with FFA_RUN.
+ */
+STATIC
+BOOLEAN
+FfaIsSecurePartition (
+  VOID
+  )
+{
+  if (mPartitionId == INVALID_SOURCE_ID) {
+    ArmFfaLibPartitionIdGet (&mPartitionId);
+  }
+
+  return (mPartitionId & FFA_SECURE_ENDPOINT_ID_BIT) != 0;
+}
+
+/*
+ * Waits for the response of a direct request sent by a normal world endpoint. The deadline
+ * is checked every time the request hands control back, the request is abandoned once
+ * TimeoutNs elapsed since Start and the preempted endpoint is otherwise run again. A secure
+ * partition handles and waits out its interrupts as FfaMessageSendDirectReq2 does, it never
+ * gets a deadline. MAX_UINT64 never expires.
+ */
+STATIC
+EFI_STATUS
+FfaWaitDirectResp2 (
+  IN      UINT16              DestPartId,
+  IN OUT  ARM_SXC_ARGS        *Result,
+  OUT     DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  IN      UINT64              Start,
+  IN      UINT64              TimeoutNs
+  )
+{
+  while (FfaIsSecurePartition () && (Result->Arg0 == ARM_FID_FFA_INTERRUPT)) {
+    mDeadlineStats.Interrupts++;
+    SecurePartitionInterruptHandler ((UINT32)Result->Arg2);
+    FfaReturnFromInterrupt (Result);
+  }
+
+  while (!FfaIsSecurePartition () &&
+         ((Result->Arg0 == ARM_FID_FFA_INTERRUPT) || (Result->Arg0 == ARM_FID_FFA_YIELD)))
+  {
+    mDeadlineStats.Interrupts++;
+
+    if ((TimeoutNs != MAX_UINT64) && (FfaElapsedNs (Start) >= TimeoutNs)) {
+      DEBUG ((DEBUG_WARN, "Direct Request to %x Abandoned After Deadline\n", DestPartId));
+      ASSERT (!mAbandonedRequest || (mAbandonedDestPartId == DestPartId));
+      mAbandonedRequest    = TRUE;
+      mAbandonedDestPartId = DestPartId;
+      mAbandonedTargetInfo = Result->Arg1;
+      mDeadlineStats.Timeouts++;
+      return EFI_TIMEOUT;
+    }
+
+    FfaRunDirectReq (Result->Arg1, Result);
+  }
+
+  mAbandonedRequest = FALSE;
+  mDeadlineStats.Completed++;
+
+  if (Result->Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Result->Arg2);
+  } else if (Result->Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_RESP2) {
+    FfaUnpackDirectMessage (Result, ImpDefArgs);
+  } else {
+    ASSERT (Result->Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+    *ImpDefArgs = (DIRECT_MSG_ARGS_EX) {
+      .FunctionId = Result->Arg0
+    };
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMessageSendDirectReq2Deadline (
+  IN      UINT16              DestPartId,
+  IN      EFI_GUID            *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  IN      UINT64              TimeoutNs
+  )
+{
+  ARM_SXC_ARGS  InputArgs = { 0 };
+  ARM_SXC_ARGS  Result    = { 0 };
+  UINT64        Start;
+
+  /* The destination of an abandoned request is still busy with it */
+  if (mAbandonedRequest) {
+    return EFI_NOT_READY;
+  }
+
+  /* A deadline needs a running performance counter and a caller that gets control back */
+  if ((TimeoutNs != MAX_UINT64) &&
+      ((GetPerformanceCounterProperties (NULL, NULL) == 0) || FfaIsSecurePartition ()))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (mPartitionId == INVALID_SOURCE_ID) {
+    ArmFfaLibPartitionIdGet (&mPartitionId);
+  }
+
+  ImpDefArgs->FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  ImpDefArgs->SourceId      = mPartitionId;
+  ImpDefArgs->DestinationId = DestPartId;
+  if (ServiceGuid != NULL) {
+    CopyMem (&(ImpDefArgs->ServiceGuid), ServiceGuid, sizeof (EFI_GUID));
+  } else {
+    ZeroMem (&(ImpDefArgs->ServiceGuid), sizeof (EFI_GUID));
+  }
+
+  FfaPackDirectMessage (&InputArgs, ImpDefArgs);
+
+  mDeadlineStats.Requests++;
+  Start = (TimeoutNs != MAX_UINT64) ? GetPerformanceCounter () : 0;
+  ArmCallSxc (&InputArgs, &Result);
+
+  return FfaWaitDirectResp2 (DestPartId, &Result, ImpDefArgs, Start, TimeoutNs);
+}
+
+EFI_STATUS
+EFIAPI
+FfaMessageResumeDirectReq2 (
+  OUT DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  IN  UINT64              TimeoutNs
+  )
+{
+  ARM_SXC_ARGS  Result = { 0 };
+  UINT64        Start;
+
+  if (!mAbandonedRequest) {
+    return EFI_NOT_FOUND;
+  }
+
+  if ((TimeoutNs != MAX_UINT64) && (GetPerformanceCounterProperties (NULL, NULL) == 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  mDeadlineStats.Resumes++;
+  Start = (TimeoutNs != MAX_UINT64) ? GetPerformanceCounter () : 0;
+  FfaRunDirectReq (mAbandonedTargetInfo, &Result);
+
+  return FfaWaitDirectResp2 (mAbandonedDestPartId, &Result, ImpDefArgs, Start, TimeoutNs);
+}
+
+VOID
+EFIAPI
+FfaDirectReqDeadlineGetStatistics (
+  OUT FFA_DIRECT_REQ_DEADLINE_STATISTICS  *Statistics
+  )
+{
+  CopyMem (Statistics, &mDeadlineStats, sizeof (FFA_DIRECT_REQ_DEADLINE_STATISTICS));
+}
+
 STATIC
 EFI_STATUS
 FfaMessageSendDirectResp (
@@ -497,6 +718,20 @@ FfaPartitionInfoGetRegs (
   IN OUT UINT32               *PartDescCount,
   OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
   )
+{
+  return FfaPartitionInfoGetRegsEx (ServiceGuid, StartIndex, Tag, NULL, PartDescCount, PartDesc);
+}
+
+EFI_STATUS
+EFIAPI
+FfaPartitionInfoGetRegsEx (
+  IN EFI_GUID                 *ServiceGuid,
+  IN UINT16                   StartIndex,
+  IN OUT UINT16               *Tag OPTIONAL,
+  OUT UINT16                  *LastIndex OPTIONAL,
+  IN OUT UINT32               *PartDescCount,
+  OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
+  )
 {
   EFI_GUID  ServiceGuidMangled;
   UINT64    Metadata     = 0;
@@ -552,6 +787,10 @@ FfaPartitionInfoGetRegs (
     *Tag = (UINT16)((Metadata >> 32) & 0xFFFF);
   }
 
+  if (LastIndex != NULL) {
+    *LastIndex = (UINT16)(Metadata & 0xFFFF);
+  }
+
   return EFI_SUCCESS;
 }
 
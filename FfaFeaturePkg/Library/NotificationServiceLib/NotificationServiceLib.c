@@ -7,6 +7,7 @@
 **/
 
 #include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/NotificationServiceLib.h>
@@ -18,7 +19,7 @@
 #define NOTIFICATION_NOT_FOUND     (-1)
 
 #define MESSAGE_INFO_DIR_RESP  (0x100)
-#define MESSAGE_INFO_ID_MASK   (0x03)
+#define MESSAGE_INFO_ID_MASK   (0x07)
 
 #define RETURN_STATUS_MASK  (0xFF)
 
@@ -265,6 +266,72 @@ LocateService (
   return Service;
 }
 
+/**
+  Removes every mapping owned by a source from a service and clears their bits
+  in the global bitmask
+
+  @param  SourceId  The ID of the source whose mappings are removed
+  @param  Service   The service to remove the mappings from
+
+  @return The number of mappings removed
+
+**/
+STATIC
+UINT32
+RemoveSourceMappings (
+  UINT16        SourceId,
+  NotifService  *Service
+  )
+{
+  UINT8   Index;
+  UINT32  Removed;
+
+  Removed = 0;
+  for (Index = 0; Index < NOTIFICATION_MAX_MAPPINGS; Index++) {
+    if (Service->ServiceInfo[Index].InUse && (Service->ServiceInfo[Index].SourceId == SourceId)) {
+      GlobalBitmask &= ~((UINT64)1 << Service->ServiceInfo[Index].Id);
+      ZeroMem (&Service->ServiceInfo[Index], sizeof (NotifInfo));
+      Removed++;
+    }
+  }
+
+  return Removed;
+}
+
+/**
+  Removes every mapping owned by a source from one or all services
+
+  @param  SourceId  The ID of the source whose mappings are removed
+  @param  Uuid      The service to remove the mappings from, NULL for all services
+
+  @return The number of mappings removed
+
+**/
+STATIC
+UINT32
+UnregisterSource (
+  UINT16  SourceId,
+  UINT8   *Uuid
+  )
+{
+  UINT8   Index;
+  UINT32  Removed;
+
+  Removed = 0;
+  for (Index = 0; Index < NOTIFICATION_MAX_SERVICES; Index++) {
+    if (!NotificationServices[Index].InUse) {
+      continue;
+    }
+
+    if ((Uuid == NULL) || !CompareMem (Uuid, NotificationServices[Index].ServiceUuid, sizeof (NotificationServices[Index].ServiceUuid))) {
+      Removed += RemoveSourceMappings (SourceId, &NotificationServices[Index]);
+    }
+  }
+
+  DEBUG ((DEBUG_INFO, "Unregistered %d Mappings of Source ID: %x\n", Removed, SourceId));
+  return Removed;
+}
+
 /**
   Handler for Notification Register command
 
@@ -353,6 +420,53 @@ UnregisterHandler (
   return ReturnVal;
 }
 
+/**
+  Handler for Notification Unregister Source command
+
+  @param  Request   The incoming message
+  @param  Removed   The number of mappings removed
+
+  @retval NOTIFICATION_STATUS_SUCCESS           Success
+  @retval NOTIFICATION_STATUS_INVALID_PARAMETER Invalid parameter
+
+**/
+STATIC
+NotificationStatus
+UnregisterSourceHandler (
+  DIRECT_MSG_ARGS_EX  *Request,
+  UINT32              *Removed
+  )
+{
+  UINT8   Uuid[16];
+  UINT16  SourceId;
+
+  *Removed = 0;
+
+  /* Source ID of the mappings to remove = Bits[0:15] of x10 (i.e. Arg6) */
+  SourceId = (UINT16)Request->Arg6;
+
+  /* Only the hypervisor may remove the mappings of another source */
+  if ((SourceId != Request->SourceId) && (Request->SourceId != FFA_HYPERVISOR_ID)) {
+    DEBUG ((DEBUG_ERROR, "Invalid Unregister Source - Source ID: %x Mismatch\n", SourceId));
+    return NOTIFICATION_STATUS_INVALID_PARAMETER;
+  }
+
+  /* A zero UUID in x7-x8 (i.e. Arg3-Arg4) removes the mappings of every service */
+  if ((Request->Arg3 == 0) && (Request->Arg4 == 0)) {
+    *Removed = UnregisterSource (SourceId, NULL);
+  } else {
+    NotificationServiceExtractUuid (Request->Arg3, Request->Arg4, Uuid);
+    if (LocateService (Uuid, FALSE) == NULL) {
+      DEBUG ((DEBUG_ERROR, "Service Unregister Source Failed - Service Not Found\n"));
+      return NOTIFICATION_STATUS_INVALID_PARAMETER;
+    }
+
+    *Removed = UnregisterSource (SourceId, Uuid);
+  }
+
+  return NOTIFICATION_STATUS_SUCCESS;
+}
+
 /**
   Initializes the Notification service
 
@@ -395,6 +509,7 @@ NotificationServiceHandle (
   )
 {
   NotificationStatus  ReturnVal;
+  UINT32              Removed;
 
   /* Validate the input parameters before attempting to dereference or pass them along */
   if ((Request == NULL) || (Response == NULL)) {
@@ -409,7 +524,7 @@ NotificationServiceHandle (
   Response->Arg4 = Request->Arg4;
   Response->Arg5 = Request->Arg5 | MESSAGE_INFO_DIR_RESP;
 
-  /* Message ID = Bits[0:1] of x9 (i.e. Arg5)*/
+  /* Message ID = Bits[0:2] of x9 (i.e. Arg5)*/
   switch (Request->Arg5 & MESSAGE_INFO_ID_MASK) {
     case NOTIFICATION_OPCODE_ADD:
     case NOTIFICATION_OPCODE_REMOVE:
@@ -431,6 +546,18 @@ NotificationServiceHandle (
       ReturnVal = UnregisterHandler (Request);
       break;
 
+    case NOTIFICATION_OPCODE_UNREGISTER_SOURCE:
+      ReturnVal = UnregisterSourceHandler (Request, &Removed);
+      /* Number of mappings removed = x11 (i.e. Arg7) */
+      Response->Arg7 = Removed;
+      break;
+
+    case NOTIFICATION_OPCODE_GET_VERSION:
+      ReturnVal = NOTIFICATION_STATUS_SUCCESS;
+      /* Version = x11 (i.e. Arg7) */
+      Response->Arg7 = (NOTIFICATION_SERVICE_MAJOR_VER << 16) | NOTIFICATION_SERVICE_MINOR_VER;
+      break;
+
     default:
       ReturnVal = NOTIFICATION_STATUS_INVALID_PARAMETER;
       DEBUG ((DEBUG_ERROR, "Invalid Notification Service Opcode\n"));
@@ -441,6 +568,76 @@ NotificationServiceHandle (
   Response->Arg6 = (((UINTN)(UINT8)ReturnVal) & RETURN_STATUS_MASK);
 }
 
+/**
+  Handler for FF-A framework messages
+
+  Removes every mapping owned by a VM once the hypervisor reports it destroyed,
+  so a VM that went away without unregistering does not leak its mappings.
+  Partitions subscribed to VM availability messages call this from their
+  message loop on every direct request, before routing it to a service by
+  UUID, see Docs/PartitionGuide.md.
+
+  @param  Request   The incoming message
+  @param  Response  The outgoing message, complete with its function and endpoint IDs
+
+  @retval TRUE   Request was a framework message handled here, send Response back
+  @retval FALSE  Request is not a framework message handled by this service
+
+**/
+BOOLEAN
+NotificationServiceHandleFrameworkMessage (
+  DIRECT_MSG_ARGS_EX  *Request,
+  DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  UINT16  VmId;
+
+  /* Validate the input parameters before attempting to dereference or pass them along */
+  if ((Request == NULL) || (Response == NULL)) {
+    return FALSE;
+  }
+
+  /* Framework messages are only sent through FFA_MSG_SEND_DIRECT_REQ, flags = x2 (i.e. Arg0) */
+  if ((Request->FunctionId != ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) &&
+      (Request->FunctionId != ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64))
+  {
+    return FALSE;
+  }
+
+  if (((Request->Arg0 & FFA_FRAMEWORK_MSG_BIT) == 0) ||
+      ((Request->Arg0 & FFA_FRAMEWORK_MSG_TYPE_MASK) != FFA_FRAMEWORK_MSG_VM_DESTROYED_REQ))
+  {
+    return FALSE;
+  }
+
+  /* Only the hypervisor reports VMs being destroyed */
+  if (Request->SourceId != FFA_HYPERVISOR_ID) {
+    DEBUG ((DEBUG_ERROR, "Ignoring VM Destroyed Message - Source ID: %x\n", Request->SourceId));
+    return FALSE;
+  }
+
+  /* VM ID = Bits[0:15] of x5 (i.e. Arg3) */
+  VmId = (UINT16)Request->Arg3;
+  UnregisterSource (VmId, NULL);
+
+  ZeroMem (Response, sizeof (DIRECT_MSG_ARGS_EX));
+  if (Request->FunctionId == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) {
+    Response->FunctionId = ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH32;
+  } else {
+    Response->FunctionId = ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH64;
+  }
+
+  Response->SourceId      = Request->DestinationId;
+  Response->DestinationId = Request->SourceId;
+  Response->Arg0          = FFA_FRAMEWORK_MSG_BIT | FFA_FRAMEWORK_MSG_VM_DESTROYED_RESP;
+  /* Status = x3 (i.e. Arg1), handle and VM ID are echoed back */
+  Response->Arg1 = 0;
+  Response->Arg2 = Request->Arg2;
+  Response->Arg3 = Request->Arg3;
+
+  return TRUE;
+}
+
 /**
   Calls NotificationSet on the given ID with the given flag
 
@@ -534,3 +731,41 @@ NotificationServiceExtractUuid (
     Uuid[Index] = UuidLoByte;
   }
 }
+
+/**
+  Reports how much of the notification tables is in use
+
+  @param  ServiceCount  The number of service slots in use
+  @param  MappingCount  The number of registered cookie/ID mappings across all services
+
+**/
+VOID
+NotificationServiceGetUsage (
+  UINT32  *ServiceCount,
+  UINT32  *MappingCount
+  )
+{
+  UINT8  ServiceIndex;
+  UINT8  MappingIndex;
+
+  /* Validate the incoming function parameters */
+  if ((ServiceCount == NULL) || (MappingCount == NULL)) {
+    return;
+  }
+
+  *ServiceCount = 0;
+  *MappingCount = 0;
+
+  for (ServiceIndex = 0; ServiceIndex < NOTIFICATION_MAX_SERVICES; ServiceIndex++) {
+    if (!NotificationServices[ServiceIndex].InUse) {
+      continue;
+    }
+
+    (*ServiceCount)++;
+    for (MappingIndex = 0; MappingIndex < NOTIFICATION_MAX_MAPPINGS; MappingIndex++) {
+      if (NotificationServices[ServiceIndex].ServiceInfo[MappingIndex].InUse) {
+        (*MappingCount)++;
+      }
+    }
+  }
+}
@@ -12,6 +12,8 @@
 #include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 
+#include "SecurePartitionMemoryAllocationLib.h"
+
 typedef struct {
   LIST_ENTRY    Link;
   UINTN         NumberOfPages;
@@ -26,6 +28,21 @@ LIST_ENTRY  mMmMemoryMap = INITIALIZE_LIST_HEAD_VARIABLE (mMmMemoryMap);
 
 UINTN  mMapKey;
 
+//
+// Number of pages added to the free page list by MmAddMemoryRegion
+//
+STATIC UINTN  mMmTotalPages;
+
+//
+// Number of pages currently on the free page list
+//
+STATIC UINTN  mMmFreePages;
+
+//
+// Number of MmAllocatePages calls that could not be satisfied
+//
+STATIC UINT64  mMmFailedPageAllocations;
+
 /**
   Internal Function. Allocate n pages from given free page node.
 
@@ -211,6 +228,7 @@ MmInternalAllocatePages (
       return EFI_INVALID_PARAMETER;
   }
 
+  mMmFreePages -= NumberOfPages;
   return EFI_SUCCESS;
 }
 
@@ -242,6 +260,19 @@ MmAllocatePages (
   EFI_STATUS  Status;
 
   Status = MmInternalAllocatePages (Type, MemoryType, NumberOfPages, Memory);
+  if ((Status == EFI_OUT_OF_RESOURCES) && MmShrink (NumberOfPages)) {
+    Status = MmInternalAllocatePages (Type, MemoryType, NumberOfPages, Memory);
+    if (!EFI_ERROR (Status)) {
+      MmShrinkRecovered ();
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    mMmFailedPageAllocations++;
+  } else {
+    MmCheckLowWaterMark ();
+  }
+
   return Status;
 }
 
@@ -337,6 +368,7 @@ MmInternalFreePages (
     InternalMergeNodes (Pages);
   }
 
+  mMmFreePages += NumberOfPages;
   return EFI_SUCCESS;
 }
 
@@ -395,5 +427,37 @@ MmAddMemoryRegion (
   //
   AlignedMemBase = (UINTN)(MemBase + EFI_PAGE_MASK) & ~EFI_PAGE_MASK;
   MemLength     -= AlignedMemBase - MemBase;
-  MmFreePages (AlignedMemBase, TRUNCATE_TO_PAGES ((UINTN)MemLength));
+  if (!EFI_ERROR (MmFreePages (AlignedMemBase, TRUNCATE_TO_PAGES ((UINTN)MemLength)))) {
+    mMmTotalPages += TRUNCATE_TO_PAGES ((UINTN)MemLength);
+  }
+}
+
+/**
+  Adds the page usage counters to the heap statistics.
+
+  @param  Statistics             Heap statistics to accumulate into.
+
+**/
+VOID
+MmGetPageStatistics (
+  IN OUT SP_MEMORY_STATISTICS  *Statistics
+  )
+{
+  Statistics->TotalPages        += mMmTotalPages;
+  Statistics->FreePages         += mMmFreePages;
+  Statistics->FailedAllocations += mMmFailedPageAllocations;
+}
+
+/**
+  Returns the number of pages on the free page list.
+
+  @return The number of free pages.
+
+**/
+UINTN
+MmGetFreePageCount (
+  VOID
+  )
+{
+  return mMmFreePages;
 }
@@ -44,6 +44,14 @@ typedef struct {
 #define MAX_POOL_INDEX  (MAX_POOL_SHIFT - MIN_POOL_SHIFT + 1)
 
 LIST_ENTRY  mMmPoolLists[MAX_POOL_INDEX];
+
+//
+// Pool usage counters reported through SpMemoryGetStatistics
+//
+STATIC UINT64  mMmPoolAllocations;
+STATIC UINT64  mMmPoolFrees;
+STATIC UINT64  mMmPoolBytesInUse;
+STATIC UINT64  mMmFailedPoolAllocations;
 //
 // To cache the MMRAM base since when Loading modules At fixed address feature is enabled,
 // all module is assigned an offset relative the MMRAM base in build time.
@@ -231,6 +239,8 @@ MmInternalAllocatePool (
     PoolHdr->Size      = EFI_PAGES_TO_SIZE (Size);
     PoolHdr->Available = FALSE;
     *Buffer            = PoolHdr + 1;
+    mMmPoolAllocations++;
+    mMmPoolBytesInUse += PoolHdr->Size;
     return Status;
   }
 
@@ -243,6 +253,8 @@ MmInternalAllocatePool (
   Status = InternalAllocPoolByIndex (PoolIndex, &FreePoolHdr);
   if (!EFI_ERROR (Status)) {
     *Buffer = &FreePoolHdr->Header + 1;
+    mMmPoolAllocations++;
+    mMmPoolBytesInUse += FreePoolHdr->Header.Size;
   }
 
   return Status;
@@ -272,6 +284,19 @@ MmAllocatePool (
   EFI_STATUS  Status;
 
   Status = MmInternalAllocatePool (PoolType, Size, Buffer);
+  if ((Status == EFI_OUT_OF_RESOURCES) && MmShrink (EFI_SIZE_TO_PAGES (Size + sizeof (POOL_HEADER)))) {
+    Status = MmInternalAllocatePool (PoolType, Size, Buffer);
+    if (!EFI_ERROR (Status)) {
+      MmShrinkRecovered ();
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    mMmFailedPoolAllocations++;
+  } else {
+    MmCheckLowWaterMark ();
+  }
+
   return Status;
 }
 
@@ -299,6 +324,9 @@ MmInternalFreePool (
   FreePoolHdr = (FREE_POOL_HEADER *)((POOL_HEADER *)Buffer - 1);
   ASSERT (!FreePoolHdr->Header.Available);
 
+  mMmPoolFrees++;
+  mMmPoolBytesInUse -= FreePoolHdr->Header.Size;
+
   if (FreePoolHdr->Header.Size > MAX_POOL_SIZE) {
     ASSERT (((UINTN)FreePoolHdr & EFI_PAGE_MASK) == 0);
     ASSERT ((FreePoolHdr->Header.Size & EFI_PAGE_MASK) == 0);
@@ -331,3 +359,20 @@ MmFreePool (
   Status = MmInternalFreePool (Buffer);
   return Status;
 }
+
+/**
+  Adds the pool usage counters to the heap statistics.
+
+  @param  Statistics             Heap statistics to accumulate into.
+
+**/
+VOID
+MmGetPoolStatistics (
+  IN OUT SP_MEMORY_STATISTICS  *Statistics
+  )
+{
+  Statistics->PoolAllocations   += mMmPoolAllocations;
+  Statistics->PoolFrees         += mMmPoolFrees;
+  Statistics->PoolBytesInUse    += mMmPoolBytesInUse;
+  Statistics->FailedAllocations += mMmFailedPoolAllocations;
+}
@@ -17,6 +17,7 @@
 #include <Library/SecurePartitionServicesTableLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/SecurePartitionMemoryLib.h>
 
 #include "SecurePartitionMemoryAllocationLib.h"
 
@@ -831,6 +832,33 @@ FreePool (
   ASSERT_EFI_ERROR (Status);
 }
 
+/**
+  Retrieves the current heap statistics of the secure partition.
+
+  @param  Statistics  Receives the heap statistics
+
+  @retval EFI_SUCCESS            The statistics were retrieved
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL
+
+**/
+EFI_STATUS
+EFIAPI
+SpMemoryGetStatistics (
+  OUT SP_MEMORY_STATISTICS  *Statistics
+  )
+{
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Statistics, sizeof (*Statistics));
+  MmGetPoolStatistics (Statistics);
+  MmGetPageStatistics (Statistics);
+  MmGetShrinkerStatistics (Statistics);
+
+  return EFI_SUCCESS;
+}
+
 STATIC
 EFI_STATUS
 ReadProperty32 (
@@ -11,6 +11,8 @@
 #ifndef SECURE_PARTITION_MEM_ALLOC_LIB_H_
 #define SECURE_PARTITION_MEM_ALLOC_LIB_H_
 
+#include <Library/SecurePartitionMemoryLib.h>
+
 /**
   Allocates pages from the memory map.
 
@@ -163,4 +165,80 @@ MmInitializeMemoryServices (
   IN EFI_MMRAM_DESCRIPTOR  *MmramRanges
   );
 
+/**
+  Adds the pool usage counters to the heap statistics.
+
+  @param  Statistics             Heap statistics to accumulate into.
+
+**/
+VOID
+MmGetPoolStatistics (
+  IN OUT SP_MEMORY_STATISTICS  *Statistics
+  );
+
+/**
+  Adds the page usage counters to the heap statistics.
+
+  @param  Statistics             Heap statistics to accumulate into.
+
+**/
+VOID
+MmGetPageStatistics (
+  IN OUT SP_MEMORY_STATISTICS  *Statistics
+  );
+
+/**
+  Returns the number of pages on the free page list.
+
+  @return The number of free pages.
+
+**/
+UINTN
+MmGetFreePageCount (
+  VOID
+  );
+
+/**
+  Asks the registered shrinkers to release memory.
+
+  @param  PagesWanted            The number of pages to recover.
+
+  @retval TRUE                   At least one shrinker released memory.
+  @retval FALSE                  Nothing was released or the shrinkers are already running.
+
+**/
+BOOLEAN
+MmShrink (
+  IN UINTN  PagesWanted
+  );
+
+/**
+  Records an allocation that succeeded after the shrinkers released memory.
+
+**/
+VOID
+MmShrinkRecovered (
+  VOID
+  );
+
+/**
+  Shrinks the registered caches once the free pages drop below the low-water mark.
+
+**/
+VOID
+MmCheckLowWaterMark (
+  VOID
+  );
+
+/**
+  Adds the shrinker counters to the heap statistics.
+
+  @param  Statistics             Heap statistics to accumulate into.
+
+**/
+VOID
+MmGetShrinkerStatistics (
+  IN OUT SP_MEMORY_STATISTICS  *Statistics
+  );
+
 #endif // SECURE_PARTITION_MEM_ALLOC_LIB_H_
@@ -0,0 +1,300 @@
+/** @file
+  Memory pressure handling for the secure partition heap.
+
+  Caches living in the secure partition register shrinkers that are asked to
+  release memory, in priority order, when an allocation would fail or when the
+  free pages drop below PcdSpMemoryLowWaterPages.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SecurePartitionMemoryLib.h>
+
+#include "SecurePartitionMemoryAllocationLib.h"
+
+#define MAX_SHRINKERS  (16)
+
+typedef struct {
+  SP_MEMORY_SHRINKER    Shrinker;
+  VOID                  *Context;
+  UINT32                Priority;
+} SHRINKER_ENTRY;
+
+//
+// Registered shrinkers, kept sorted by ascending priority
+//
+STATIC SHRINKER_ENTRY  mShrinkers[MAX_SHRINKERS];
+STATIC UINTN           mShrinkerCount;
+
+//
+// Set while the shrinkers run so allocations made by them do not shrink again
+//
+STATIC BOOLEAN  mShrinkInProgress;
+
+//
+// Set when a shrinker was unregistered while the shrinkers run, its entry is removed afterwards
+//
+STATIC BOOLEAN  mShrinkerRemovalPending;
+
+//
+// Set once the free pages dropped below the low-water mark, cleared when they recover
+//
+STATIC BOOLEAN  mBelowLowWaterMark;
+
+STATIC UINT64  mShrinkEvents;
+STATIC UINT64  mShrinkPagesReleased;
+STATIC UINT64  mShrinkRecoveredAllocations;
+
+/**
+  Registers a shrinker that is asked to release memory under memory pressure.
+
+  Shrinkers are called in ascending Priority order until enough pages were
+  released, so caches that are cheapest to rebuild should use lower values.
+
+  @param  Shrinker  The function releasing memory
+  @param  Context   The context passed to Shrinker
+  @param  Priority  The order Shrinker is called in, lower values are called first
+
+  @retval EFI_SUCCESS            The shrinker was registered
+  @retval EFI_INVALID_PARAMETER  Shrinker is NULL
+  @retval EFI_ALREADY_STARTED    Shrinker is already registered with Context
+  @retval EFI_OUT_OF_RESOURCES   The shrinker table is full
+  @retval EFI_NOT_READY          The shrinkers are running, the table cannot change order
+
+**/
+EFI_STATUS
+EFIAPI
+SpMemoryRegisterShrinker (
+  IN SP_MEMORY_SHRINKER  Shrinker,
+  IN VOID                *Context OPTIONAL,
+  IN UINT32              Priority
+  )
+{
+  UINTN  Index;
+  UINTN  Insert;
+
+  if (Shrinker == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (mShrinkInProgress) {
+    return EFI_NOT_READY;
+  }
+
+  for (Index = 0; Index < mShrinkerCount; Index++) {
+    if ((mShrinkers[Index].Shrinker == Shrinker) && (mShrinkers[Index].Context == Context)) {
+      return EFI_ALREADY_STARTED;
+    }
+  }
+
+  if (mShrinkerCount == MAX_SHRINKERS) {
+    DEBUG ((DEBUG_ERROR, "%a: Shrinker table full\n", __func__));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Shrinkers of equal priority run in registration order
+  //
+  for (Insert = mShrinkerCount; Insert > 0; Insert--) {
+    if (mShrinkers[Insert - 1].Priority <= Priority) {
+      break;
+    }
+
+    mShrinkers[Insert] = mShrinkers[Insert - 1];
+  }
+
+  mShrinkers[Insert].Shrinker = Shrinker;
+  mShrinkers[Insert].Context  = Context;
+  mShrinkers[Insert].Priority = Priority;
+  mShrinkerCount++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Removes the entries of shrinkers unregistered while the shrinkers ran.
+
+**/
+STATIC
+VOID
+RemovePendingShrinkers (
+  VOID
+  )
+{
+  UINTN  Index;
+  UINTN  Kept;
+
+  Kept = 0;
+  for (Index = 0; Index < mShrinkerCount; Index++) {
+    if (mShrinkers[Index].Shrinker != NULL) {
+      mShrinkers[Kept++] = mShrinkers[Index];
+    }
+  }
+
+  ZeroMem (&mShrinkers[Kept], (mShrinkerCount - Kept) * sizeof (SHRINKER_ENTRY));
+  mShrinkerCount          = Kept;
+  mShrinkerRemovalPending = FALSE;
+}
+
+/**
+  Unregisters a shrinker registered by SpMemoryRegisterShrinker.
+
+  A shrinker may unregister itself or another shrinker while it runs, the
+  entry is then removed once all shrinkers returned.
+
+  @param  Shrinker  The function releasing memory
+  @param  Context   The context Shrinker was registered with
+
+  @retval EFI_SUCCESS    The shrinker was unregistered
+  @retval EFI_NOT_FOUND  Shrinker is not registered with Context
+
+**/
+EFI_STATUS
+EFIAPI
+SpMemoryUnregisterShrinker (
+  IN SP_MEMORY_SHRINKER  Shrinker,
+  IN VOID                *Context OPTIONAL
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < mShrinkerCount; Index++) {
+    if ((mShrinkers[Index].Shrinker == Shrinker) && (mShrinkers[Index].Context == Context)) {
+      break;
+    }
+  }
+
+  if ((Shrinker == NULL) || (Index == mShrinkerCount)) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Removing the entry now would shift the table under the running walk
+  //
+  if (mShrinkInProgress) {
+    mShrinkers[Index].Shrinker = NULL;
+    mShrinkerRemovalPending    = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  CopyMem (
+    &mShrinkers[Index],
+    &mShrinkers[Index + 1],
+    (mShrinkerCount - Index - 1) * sizeof (SHRINKER_ENTRY)
+    );
+  mShrinkerCount--;
+  ZeroMem (&mShrinkers[mShrinkerCount], sizeof (SHRINKER_ENTRY));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Asks the registered shrinkers to release memory.
+
+  @param  PagesWanted            The number of pages to recover.
+
+  @retval TRUE                   At least one shrinker released memory.
+  @retval FALSE                  Nothing was released or the shrinkers are already running.
+
+**/
+BOOLEAN
+MmShrink (
+  IN UINTN  PagesWanted
+  )
+{
+  UINTN  Index;
+  UINTN  Released;
+
+  if ((mShrinkerCount == 0) || mShrinkInProgress) {
+    return FALSE;
+  }
+
+  mShrinkInProgress = TRUE;
+  mShrinkEvents++;
+
+  Released = 0;
+  for (Index = 0; (Index < mShrinkerCount) && (Released < PagesWanted); Index++) {
+    if (mShrinkers[Index].Shrinker == NULL) {
+      continue;
+    }
+
+    Released += mShrinkers[Index].Shrinker (mShrinkers[Index].Context, PagesWanted - Released);
+  }
+
+  mShrinkPagesReleased += Released;
+  mShrinkInProgress     = FALSE;
+
+  if (mShrinkerRemovalPending) {
+    RemovePendingShrinkers ();
+  }
+
+  DEBUG ((DEBUG_VERBOSE, "%a: %lu of %lu pages released\n", __func__, (UINT64)Released, (UINT64)PagesWanted));
+  return Released != 0;
+}
+
+/**
+  Records an allocation that succeeded after the shrinkers released memory.
+
+**/
+VOID
+MmShrinkRecovered (
+  VOID
+  )
+{
+  mShrinkRecoveredAllocations++;
+}
+
+/**
+  Shrinks the registered caches once the free pages drop below the low-water mark.
+
+  The shrinkers run once per crossing of the mark so a heap that stays low does
+  not call them on every allocation.
+
+**/
+VOID
+MmCheckLowWaterMark (
+  VOID
+  )
+{
+  UINTN  LowWaterPages;
+  UINTN  FreePages;
+
+  LowWaterPages = FixedPcdGet32 (PcdSpMemoryLowWaterPages);
+  if (LowWaterPages == 0) {
+    return;
+  }
+
+  FreePages = MmGetFreePageCount ();
+  if (FreePages >= LowWaterPages) {
+    mBelowLowWaterMark = FALSE;
+    return;
+  }
+
+  if (!mBelowLowWaterMark && !mShrinkInProgress) {
+    mBelowLowWaterMark = TRUE;
+    MmShrink (LowWaterPages - FreePages);
+  }
+}
+
+/**
+  Adds the shrinker counters to the heap statistics.
+
+  @param  Statistics             Heap statistics to accumulate into.
+
+**/
+VOID
+MmGetShrinkerStatistics (
+  IN OUT SP_MEMORY_STATISTICS  *Statistics
+  )
+{
+  Statistics->ShrinkEvents               += mShrinkEvents;
+  Statistics->ShrinkPagesReleased        += mShrinkPagesReleased;
+  Statistics->ShrinkRecoveredAllocations += mShrinkRecoveredAllocations;
+}
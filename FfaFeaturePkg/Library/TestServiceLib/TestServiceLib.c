@@ -9,8 +9,11 @@
 #include <Uefi.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/TimerLib.h>
 #include <Library/TestServiceLib.h>
 #include <Library/NotificationServiceLib.h>
+#include <Library/SecurePartitionMemoryLib.h>
+#include <Library/TpmServiceLib.h>
 #include <Guid/TestServiceFfa.h>
 #include <Guid/NotificationServiceFfa.h>
 
@@ -61,6 +64,95 @@ TestNotificationHandler (
   return ReturnVal;
 }
 
+/**
+  Handler for Test Telemetry command
+
+  @param  Request   The incoming message
+  @param  Response  The outgoing message
+
+  @retval TEST_STATUS_SUCCESS           Success
+  @retval TEST_STATUS_GENERIC_ERROR     Heap statistics unavailable
+
+**/
+STATIC
+TestStatus
+TestTelemetryHandler (
+  DIRECT_MSG_ARGS_EX  *Request,
+  DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  SP_MEMORY_STATISTICS       MemStats;
+  TPM_PCR_SHADOW_STATISTICS  PcrShadowStats;
+  UINT32                     ServiceCount;
+  UINT32                     MappingCount;
+  TestStatus                 ReturnVal;
+  EFI_STATUS                 Status;
+
+  ReturnVal = TEST_STATUS_GENERIC_ERROR;
+
+  Status = SpMemoryGetStatistics (&MemStats);
+  if (!EFI_ERROR (Status)) {
+    Status = TpmServiceGetPcrShadowStatistics (&PcrShadowStats);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    NotificationServiceGetUsage (&ServiceCount, &MappingCount);
+
+    Response->Arg1 = MemStats.PoolBytesInUse;
+    Response->Arg2 = MemStats.PoolAllocations;
+    Response->Arg3 = MemStats.PoolFrees;
+    Response->Arg4 = MemStats.FailedAllocations;
+    Response->Arg5 = MemStats.TotalPages;
+    Response->Arg6 = MemStats.FreePages;
+    Response->Arg7 = ServiceCount;
+    Response->Arg8 = MappingCount;
+    Response->Arg9  = MemStats.ShrinkEvents;
+    Response->Arg10 = PcrShadowStats.Hits;
+    Response->Arg11 = PcrShadowStats.Misses;
+    Response->Arg12 = PcrShadowStats.Resyncs;
+    Response->Arg13 = PcrShadowStats.Invalidations;
+    ReturnVal       = TEST_STATUS_SUCCESS;
+  } else {
+    DEBUG ((DEBUG_ERROR, "Test Telemetry Handler Failed\n"));
+  }
+
+  Response->Arg0 = ReturnVal;
+  return ReturnVal;
+}
+
+/**
+  Handler for Test Busy Wait command
+
+  @param  Request   The incoming message
+  @param  Response  The outgoing message
+
+  @retval TEST_STATUS_SUCCESS           Success
+  @retval TEST_STATUS_INVALID_PARAMETER Busy wait too long
+
+**/
+STATIC
+TestStatus
+TestBusyWaitHandler (
+  DIRECT_MSG_ARGS_EX  *Request,
+  DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  TestStatus  ReturnVal;
+
+  ReturnVal = TEST_STATUS_INVALID_PARAMETER;
+
+  /* Microseconds to stay busy = x5 (i.e. Arg1) */
+  if (Request->Arg1 <= TEST_BUSY_WAIT_MAX_US) {
+    MicroSecondDelay (Request->Arg1);
+    ReturnVal = TEST_STATUS_SUCCESS;
+  } else {
+    DEBUG ((DEBUG_ERROR, "Test Busy Wait Handler Failed\n"));
+  }
+
+  Response->Arg0 = ReturnVal;
+  return ReturnVal;
+}
+
 /**
   Initializes the Test service
 
@@ -109,6 +201,14 @@ TestServiceHandle (
       TestNotificationHandler (Request, Response);
       break;
 
+    case TEST_OPCODE_GET_TELEMETRY:
+      TestTelemetryHandler (Request, Response);
+      break;
+
+    case TEST_OPCODE_BUSY_WAIT:
+      TestBusyWaitHandler (Request, Response);
+      break;
+
     default:
       Response->Arg0 = TEST_STATUS_INVALID_PARAMETER;
       DEBUG ((DEBUG_ERROR, "Invalid Test Service Opcode\n"));
@@ -0,0 +1,572 @@
+/** @file
+  PCR shadow of the TPM Service. PCR values returned by the TPM for
+  TPM2_PCR_Read are kept so later reads of the same PCRs can be answered
+  without going through the TPM.
+
+  The shadow only answers while it knows the pcrUpdateCounter of the TPM.
+  A successful extend changes the counter in a TPM specific way, so the
+  extended PCR and the counter are invalidated and learnt again from the
+  next TPM2_PCR_Read the TPM answers. Commands that may change PCRs in ways
+  that cannot be tracked, such as TPM2_PCR_Reset, TPM2_Startup or vendor
+  specific commands, discard the whole shadow.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <IndustryStandard/Tpm20.h>
+
+#include "PcrShadow.h"
+
+/* PCR Shadow Defines */
+#define PCR_SHADOW_NUM_BANKS  (4)
+
+/* Maximum number of digests a TPM returns for one TPM2_PCR_Read */
+#define PCR_READ_MAX_DIGESTS  (8)
+
+/* Vendor specific command codes, their effect on PCRs is unknown */
+#define TPM_CC_VENDOR_BIT  (BIT29)
+
+/* PCR Shadow Structures */
+typedef struct {
+  TPMI_ALG_HASH    HashAlg;
+  UINT16           DigestSize;
+  BOOLEAN          Valid[IMPLEMENTATION_PCR];
+  UINT8            Digest[IMPLEMENTATION_PCR][SHA512_DIGEST_SIZE];
+} PcrShadowBank;
+
+/* PCR Shadow Variables */
+STATIC PcrShadowBank              mBanks[PCR_SHADOW_NUM_BANKS] = {
+  { TPM_ALG_SHA1,   SHA1_DIGEST_SIZE   },
+  { TPM_ALG_SHA256, SHA256_DIGEST_SIZE },
+  { TPM_ALG_SHA384, SHA384_DIGEST_SIZE },
+  { TPM_ALG_SHA512, SHA512_DIGEST_SIZE }
+};
+STATIC BOOLEAN                    mUpdateCounterValid;
+STATIC UINT32                     mUpdateCounter;
+STATIC BOOLEAN                    mReadPending;
+STATIC TPM_PCR_SHADOW_STATISTICS  mStatistics;
+
+/**
+  Reads a big endian UINT16 from a TPM buffer
+
+**/
+STATIC
+UINT16
+ReadBe16 (
+  CONST UINT8  *Buffer
+  )
+{
+  return SwapBytes16 (ReadUnaligned16 ((CONST UINT16 *)Buffer));
+}
+
+/**
+  Reads a big endian UINT32 from a TPM buffer
+
+**/
+STATIC
+UINT32
+ReadBe32 (
+  CONST UINT8  *Buffer
+  )
+{
+  return SwapBytes32 (ReadUnaligned32 ((CONST UINT32 *)Buffer));
+}
+
+/**
+  Writes a big endian UINT16 to a TPM buffer
+
+**/
+STATIC
+VOID
+WriteBe16 (
+  UINT8   *Buffer,
+  UINT16  Value
+  )
+{
+  WriteUnaligned16 ((UINT16 *)Buffer, SwapBytes16 (Value));
+}
+
+/**
+  Writes a big endian UINT32 to a TPM buffer
+
+**/
+STATIC
+VOID
+WriteBe32 (
+  UINT8   *Buffer,
+  UINT32  Value
+  )
+{
+  WriteUnaligned32 ((UINT32 *)Buffer, SwapBytes32 (Value));
+}
+
+/**
+  Finds the shadow bank of a hash algorithm
+
+  @param  HashAlg  The hash algorithm of the bank
+
+  @return The bank, NULL if the hash algorithm is not shadowed
+
+**/
+STATIC
+PcrShadowBank *
+FindBank (
+  TPMI_ALG_HASH  HashAlg
+  )
+{
+  UINT8  Index;
+
+  for (Index = 0; Index < PCR_SHADOW_NUM_BANKS; Index++) {
+    if (mBanks[Index].HashAlg == HashAlg) {
+      return &mBanks[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Discards all shadowed PCR values
+
+  @param  Reason  The command code that caused the resync, for debugging
+
+**/
+STATIC
+VOID
+Resync (
+  UINT32  Reason
+  )
+{
+  UINT8  Index;
+
+  for (Index = 0; Index < PCR_SHADOW_NUM_BANKS; Index++) {
+    ZeroMem (mBanks[Index].Valid, sizeof (mBanks[Index].Valid));
+  }
+
+  mUpdateCounterValid = FALSE;
+  mStatistics.Resyncs++;
+  DEBUG ((DEBUG_INFO, "PCR Shadow Resync - Command: %x\n", Reason));
+}
+
+/**
+  Invalidates a PCR in every bank along with the update counter
+
+  @param  PcrHandle  The handle of the PCR changed by a command
+
+**/
+STATIC
+VOID
+InvalidatePcr (
+  UINT32  PcrHandle
+  )
+{
+  UINT8  Index;
+
+  /* TPM_RH_NULL extends nothing */
+  if (PcrHandle == TPM_RH_NULL) {
+    return;
+  }
+
+  if (PcrHandle >= IMPLEMENTATION_PCR) {
+    Resync (PcrHandle);
+    return;
+  }
+
+  for (Index = 0; Index < PCR_SHADOW_NUM_BANKS; Index++) {
+    mBanks[Index].Valid[PcrHandle] = FALSE;
+  }
+
+  mUpdateCounterValid = FALSE;
+  mStatistics.Invalidations++;
+}
+
+/**
+  Walks a TPML_PCR_SELECTION and checks it only selects shadowed banks
+
+  @param  Selection     The start of the TPML_PCR_SELECTION
+  @param  End           The end of the buffer holding Selection
+  @param  Size          Returns the size of the TPML_PCR_SELECTION
+  @param  DigestCount   Returns the number of PCRs selected
+
+  @retval TRUE   The selection is well formed and only selects shadowed banks
+  @retval FALSE  The selection cannot be handled by the shadow
+
+**/
+STATIC
+BOOLEAN
+ParsePcrSelection (
+  CONST UINT8  *Selection,
+  CONST UINT8  *End,
+  UINT32       *Size,
+  UINT32       *DigestCount
+  )
+{
+  CONST UINT8  *Cursor;
+  UINT32       Count;
+  UINT32       Index;
+  UINT8        SizeOfSelect;
+  UINT8        Byte;
+
+  if ((End - Selection) < (INTN)sizeof (UINT32)) {
+    return FALSE;
+  }
+
+  Count = ReadBe32 (Selection);
+  if (Count > HASH_COUNT) {
+    return FALSE;
+  }
+
+  Cursor       = Selection + sizeof (UINT32);
+  *DigestCount = 0;
+  for (Index = 0; Index < Count; Index++) {
+    if ((End - Cursor) < (INTN)(sizeof (TPMI_ALG_HASH) + sizeof (UINT8))) {
+      return FALSE;
+    }
+
+    if (FindBank (ReadBe16 (Cursor)) == NULL) {
+      return FALSE;
+    }
+
+    SizeOfSelect = Cursor[sizeof (TPMI_ALG_HASH)];
+    Cursor      += sizeof (TPMI_ALG_HASH) + sizeof (UINT8);
+    if ((SizeOfSelect > PCR_SELECT_MAX) || ((End - Cursor) < SizeOfSelect)) {
+      return FALSE;
+    }
+
+    for (Byte = 0; Byte < SizeOfSelect; Byte++) {
+      *DigestCount += (UINT32)BitFieldCountOnes32 (Cursor[Byte], 0, 7);
+    }
+
+    Cursor += SizeOfSelect;
+  }
+
+  *Size = (UINT32)(Cursor - Selection);
+  return TRUE;
+}
+
+/**
+  Answers a TPM2_PCR_Read from the shadow
+
+  @param  Buffer        The command on input, the response if TRUE is returned
+  @param  CommandSize   The size of the command in Buffer
+  @param  ResponseSize  The size of the response the client accepts in Buffer
+
+  @retval TRUE   The response was built from the shadow
+  @retval FALSE  Not every selected PCR is known, the command must go to the TPM
+
+**/
+STATIC
+BOOLEAN
+AnswerPcrRead (
+  UINT8   *Buffer,
+  UINT32  CommandSize,
+  UINT32  ResponseSize
+  )
+{
+  UINT8          Selection[sizeof (TPML_PCR_SELECTION)];
+  UINT32         SelectionSize;
+  UINT32         DigestCount;
+  UINT32         AnswerSize;
+  UINT32         Count;
+  UINT32         Index;
+  UINT8          SizeOfSelect;
+  UINT8          *Cursor;
+  UINT8          *Digests;
+  UINT32         Pcr;
+  PcrShadowBank  *Bank;
+
+  if (!mUpdateCounterValid) {
+    return FALSE;
+  }
+
+  /* Copy the selection first, it is only validated and walked in the copy */
+  SelectionSize = MIN (CommandSize - (UINT32)sizeof (TPM2_COMMAND_HEADER), (UINT32)sizeof (Selection));
+  CopyMem (Selection, Buffer + sizeof (TPM2_COMMAND_HEADER), SelectionSize);
+  if (!ParsePcrSelection (Selection, Selection + SelectionSize, &SelectionSize, &DigestCount)) {
+    return FALSE;
+  }
+
+  /* Leave partial answers of large selections to the TPM */
+  if ((DigestCount == 0) || (DigestCount > PCR_READ_MAX_DIGESTS)) {
+    return FALSE;
+  }
+
+  /* Check every selected PCR is known and work out the response size */
+  Count      = ReadBe32 (Selection);
+  Cursor     = Selection + sizeof (UINT32);
+  AnswerSize = sizeof (TPM2_RESPONSE_HEADER) + sizeof (UINT32) + SelectionSize + sizeof (UINT32);
+  for (Index = 0; Index < Count; Index++) {
+    Bank         = FindBank (ReadBe16 (Cursor));
+    SizeOfSelect = Cursor[sizeof (TPMI_ALG_HASH)];
+    Cursor      += sizeof (TPMI_ALG_HASH) + sizeof (UINT8);
+    for (Pcr = 0; Pcr < (UINT32)SizeOfSelect * 8; Pcr++) {
+      if ((Cursor[Pcr / 8] & (1 << (Pcr % 8))) == 0) {
+        continue;
+      }
+
+      if ((Bank == NULL) || (Pcr >= IMPLEMENTATION_PCR) || !Bank->Valid[Pcr]) {
+        return FALSE;
+      }
+
+      AnswerSize += sizeof (UINT16) + Bank->DigestSize;
+    }
+
+    Cursor += SizeOfSelect;
+  }
+
+  /* A client that cannot take the whole response gets it from the TPM */
+  if (AnswerSize > ResponseSize) {
+    return FALSE;
+  }
+
+  /* Build the response: header, pcrUpdateCounter, pcrSelectionOut, pcrValues */
+  WriteBe16 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, tag), TPM_ST_NO_SESSIONS);
+  WriteBe32 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, paramSize), AnswerSize);
+  WriteBe32 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, responseCode), TPM_RC_SUCCESS);
+  Digests = Buffer + sizeof (TPM2_RESPONSE_HEADER);
+  WriteBe32 (Digests, mUpdateCounter);
+  Digests += sizeof (UINT32);
+  CopyMem (Digests, Selection, SelectionSize);
+  Digests += SelectionSize;
+  WriteBe32 (Digests, DigestCount);
+  Digests += sizeof (UINT32);
+
+  Cursor = Selection + sizeof (UINT32);
+  for (Index = 0; Index < Count; Index++) {
+    Bank         = FindBank (ReadBe16 (Cursor));
+    SizeOfSelect = Cursor[sizeof (TPMI_ALG_HASH)];
+    Cursor      += sizeof (TPMI_ALG_HASH) + sizeof (UINT8);
+    for (Pcr = 0; Pcr < (UINT32)SizeOfSelect * 8; Pcr++) {
+      if ((Cursor[Pcr / 8] & (1 << (Pcr % 8))) == 0) {
+        continue;
+      }
+
+      WriteBe16 (Digests, Bank->DigestSize);
+      Digests += sizeof (UINT16);
+      CopyMem (Digests, Bank->Digest[Pcr], Bank->DigestSize);
+      Digests += Bank->DigestSize;
+    }
+
+    Cursor += SizeOfSelect;
+  }
+
+  return TRUE;
+}
+
+/**
+  Discards all shadowed PCR values
+
+**/
+VOID
+PcrShadowInit (
+  VOID
+  )
+{
+  UINT8  Index;
+
+  for (Index = 0; Index < PCR_SHADOW_NUM_BANKS; Index++) {
+    ZeroMem (mBanks[Index].Valid, sizeof (mBanks[Index].Valid));
+  }
+
+  mUpdateCounterValid = FALSE;
+  mReadPending        = FALSE;
+  ZeroMem (&mStatistics, sizeof (mStatistics));
+}
+
+/**
+  Inspects a command before it is sent to the TPM
+
+  TPM2_PCR_Read commands are answered from the shadow if every selected PCR
+  is known. Commands changing PCRs invalidate what they change, commands the
+  shadow cannot model discard it.
+
+  @param  Buffer        A private copy of the command on input, the response if TRUE is returned
+  @param  CommandSize   The size of the command the client placed in Buffer
+  @param  ResponseSize  The size of the response the client accepts in Buffer
+
+  @retval TRUE   The command was answered from the shadow, Buffer holds the response
+  @retval FALSE  The command must be sent to the TPM
+
+**/
+BOOLEAN
+PcrShadowHandleCommand (
+  UINT8   *Buffer,
+  UINT32  CommandSize,
+  UINT32  ResponseSize
+  )
+{
+  UINT16  Tag;
+  UINT32  ParamSize;
+  UINT32  CommandCode;
+
+  mReadPending = FALSE;
+
+  if (CommandSize < sizeof (TPM2_COMMAND_HEADER)) {
+    Resync (0);
+    return FALSE;
+  }
+
+  Tag         = ReadBe16 (Buffer + OFFSET_OF (TPM2_COMMAND_HEADER, tag));
+  ParamSize   = ReadBe32 (Buffer + OFFSET_OF (TPM2_COMMAND_HEADER, paramSize));
+  CommandCode = ReadBe32 (Buffer + OFFSET_OF (TPM2_COMMAND_HEADER, commandCode));
+  if ((ParamSize < sizeof (TPM2_COMMAND_HEADER)) || (ParamSize > CommandSize)) {
+    Resync (CommandCode);
+    return FALSE;
+  }
+
+  if ((CommandCode & TPM_CC_VENDOR_BIT) != 0) {
+    Resync (CommandCode);
+    return FALSE;
+  }
+
+  switch (CommandCode) {
+    case TPM_CC_PCR_Read:
+      /* Reads in audit sessions are left to the TPM */
+      if (Tag != TPM_ST_NO_SESSIONS) {
+        break;
+      }
+
+      if (AnswerPcrRead (Buffer, ParamSize, ResponseSize)) {
+        mStatistics.Hits++;
+        return TRUE;
+      }
+
+      mStatistics.Misses++;
+      mReadPending = TRUE;
+      break;
+
+    /* The PCR being changed is the first handle of these commands */
+    case TPM_CC_PCR_Extend:
+    case TPM_CC_PCR_Event:
+    case TPM_CC_EventSequenceComplete:
+      if (ParamSize < sizeof (TPM2_COMMAND_HEADER) + sizeof (TPMI_DH_PCR)) {
+        Resync (CommandCode);
+        break;
+      }
+
+      InvalidatePcr (ReadBe32 (Buffer + sizeof (TPM2_COMMAND_HEADER)));
+      break;
+
+    case TPM_CC_PCR_Reset:
+    case TPM_CC_PCR_Allocate:
+    case TPM_CC_Startup:
+    case TPM_CC_FieldUpgradeStart:
+    case TPM_CC_FieldUpgradeData:
+      Resync (CommandCode);
+      break;
+
+    default:
+      break;
+  }
+
+  return FALSE;
+}
+
+/**
+  Learns PCR values from the TPM response to the last command passed to
+  PcrShadowHandleCommand
+
+  @param  Buffer        A private copy of the response of the TPM, never the CRB data buffer
+  @param  ResponseSize  The size of the response the client accepts in Buffer
+
+**/
+VOID
+PcrShadowHandleResponse (
+  UINT8   *Buffer,
+  UINT32  ResponseSize
+  )
+{
+  CONST UINT8    *End;
+  CONST UINT8    *Selection;
+  CONST UINT8    *Cursor;
+  CONST UINT8    *Digests;
+  UINT32         UpdateCounter;
+  UINT32         SelectionSize;
+  UINT32         DigestCount;
+  UINT32         Count;
+  UINT32         Index;
+  UINT8          SizeOfSelect;
+  UINT32         Pcr;
+  UINT16         DigestSize;
+  PcrShadowBank  *Bank;
+
+  if (!mReadPending) {
+    return;
+  }
+
+  mReadPending = FALSE;
+
+  if ((ResponseSize < sizeof (TPM2_RESPONSE_HEADER) + sizeof (UINT32)) ||
+      (ReadBe16 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, tag)) != TPM_ST_NO_SESSIONS) ||
+      (ReadBe32 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, responseCode)) != TPM_RC_SUCCESS) ||
+      (ReadBe32 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, paramSize)) > ResponseSize))
+  {
+    return;
+  }
+
+  End           = Buffer + ReadBe32 (Buffer + OFFSET_OF (TPM2_RESPONSE_HEADER, paramSize));
+  UpdateCounter = ReadBe32 (Buffer + sizeof (TPM2_RESPONSE_HEADER));
+  Selection     = Buffer + sizeof (TPM2_RESPONSE_HEADER) + sizeof (UINT32);
+  if (!ParsePcrSelection (Selection, End, &SelectionSize, &DigestCount)) {
+    return;
+  }
+
+  /* The TPM returns a digest per PCR left selected in pcrSelectionOut */
+  Digests = Selection + SelectionSize;
+  if (((End - Digests) < (INTN)sizeof (UINT32)) || (ReadBe32 (Digests) != DigestCount)) {
+    return;
+  }
+
+  Digests += sizeof (UINT32);
+  Count    = ReadBe32 (Selection);
+  Cursor   = Selection + sizeof (UINT32);
+  for (Index = 0; Index < Count; Index++) {
+    Bank         = FindBank (ReadBe16 (Cursor));
+    SizeOfSelect = Cursor[sizeof (TPMI_ALG_HASH)];
+    Cursor      += sizeof (TPMI_ALG_HASH) + sizeof (UINT8);
+    for (Pcr = 0; Pcr < (UINT32)SizeOfSelect * 8; Pcr++) {
+      if ((Cursor[Pcr / 8] & (1 << (Pcr % 8))) == 0) {
+        continue;
+      }
+
+      if ((End - Digests) < (INTN)sizeof (UINT16)) {
+        return;
+      }
+
+      DigestSize = ReadBe16 (Digests);
+      Digests   += sizeof (UINT16);
+      if ((Bank == NULL) || (Pcr >= IMPLEMENTATION_PCR) || (DigestSize != Bank->DigestSize) || ((End - Digests) < DigestSize)) {
+        return;
+      }
+
+      CopyMem (Bank->Digest[Pcr], Digests, DigestSize);
+      Bank->Valid[Pcr] = TRUE;
+      Digests         += DigestSize;
+    }
+
+    Cursor += SizeOfSelect;
+  }
+
+  mUpdateCounter      = UpdateCounter;
+  mUpdateCounterValid = TRUE;
+}
+
+/**
+  Retrieves the PCR shadow counters
+
+  @param  Statistics  Returns the PCR shadow counters
+
+**/
+VOID
+PcrShadowGetStatistics (
+  TPM_PCR_SHADOW_STATISTICS  *Statistics
+  )
+{
+  CopyMem (Statistics, &mStatistics, sizeof (TPM_PCR_SHADOW_STATISTICS));
+}
@@ -0,0 +1,70 @@
+/** @file
+  Definitions for the PCR shadow of the TPM Service
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef PCR_SHADOW_H_
+#define PCR_SHADOW_H_
+
+#include <Library/TpmServiceLib.h>
+
+/**
+  Discards all shadowed PCR values
+
+**/
+VOID
+PcrShadowInit (
+  VOID
+  );
+
+/**
+  Inspects a command before it is sent to the TPM
+
+  TPM2_PCR_Read commands are answered from the shadow if every selected PCR
+  is known. Commands changing PCRs invalidate what they change, commands the
+  shadow cannot model discard it.
+
+  @param  Buffer        A private copy of the command on input, the response if TRUE is returned
+  @param  CommandSize   The size of the command the client placed in Buffer
+  @param  ResponseSize  The size of the response the client accepts in Buffer
+
+  @retval TRUE   The command was answered from the shadow, Buffer holds the response
+  @retval FALSE  The command must be sent to the TPM
+
+**/
+BOOLEAN
+PcrShadowHandleCommand (
+  UINT8   *Buffer,
+  UINT32  CommandSize,
+  UINT32  ResponseSize
+  );
+
+/**
+  Learns PCR values from the TPM response to the last command passed to
+  PcrShadowHandleCommand
+
+  @param  Buffer        A private copy of the response of the TPM, never the CRB data buffer
+  @param  ResponseSize  The size of the response the client accepts in Buffer
+
+**/
+VOID
+PcrShadowHandleResponse (
+  UINT8   *Buffer,
+  UINT32  ResponseSize
+  );
+
+/**
+  Retrieves the PCR shadow counters
+
+  @param  Statistics  Returns the PCR shadow counters
+
+**/
+VOID
+PcrShadowGetStatistics (
+  TPM_PCR_SHADOW_STATISTICS  *Statistics
+  );
+
+#endif /* PCR_SHADOW_H_ */
@@ -28,6 +28,8 @@
 #include <IndustryStandard/TpmPtp.h>
 #include <IndustryStandard/Tpm20.h>
 
+#include "PcrShadow.h"
+
 /* TPM Service Defines */
 #define TPM_MAJOR_VER  (0x1)
 #define TPM_MINOR_VER  (0x0)
@@ -203,6 +205,59 @@ CleanInternalCrb (
   /* Remaining registers can be ignored. */
 }
 
+/**
+  Executes the command in the CRB data buffer
+
+  PCR reads are answered from the PCR shadow when it is enabled and holds
+  every PCR selected, all other commands are forwarded to the TPM. The shadow
+  inspects and learns from a copy private to the secure partition, the TPM
+  executes that same copy so the client cannot change either behind its back.
+
+  @param  InternalTpmCrb  The CRB of the active locality
+
+  @retval EFI_SUCCESS  The response is in the CRB data buffer
+  @retval Others       The command could not be executed
+
+**/
+STATIC
+EFI_STATUS
+ExecuteCommand (
+  PTP_CRB_REGISTERS_PTR  InternalTpmCrb
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       TpmCommandBuffer[sizeof (InternalTpmCrb->CrbDataBuffer)];
+  UINT32      CommandSize;
+  UINT32      ResponseSize;
+
+  if (!FixedPcdGetBool (PcdTpmServicePcrShadow)) {
+    return TpmSstStart (mActiveLocality, InternalTpmCrb);
+  }
+
+  /* The shadow only sees the command and response sizes the client set up */
+  CommandSize  = InternalTpmCrb->CrbControlCommandSize;
+  ResponseSize = InternalTpmCrb->CrbControlResponseSize;
+  CommandSize  = MIN (CommandSize, (UINT32)sizeof (InternalTpmCrb->CrbDataBuffer));
+  ResponseSize = MIN (ResponseSize, (UINT32)sizeof (InternalTpmCrb->CrbDataBuffer));
+
+  /* Copy the CRB command data to the local buffer. */
+  SetMem (TpmCommandBuffer, sizeof (TpmCommandBuffer), 0);
+  CopyMem (TpmCommandBuffer, InternalTpmCrb->CrbDataBuffer, CommandSize);
+
+  if (PcrShadowHandleCommand (TpmCommandBuffer, CommandSize, ResponseSize)) {
+    DEBUG ((DEBUG_INFO, "PCR Read Answered From Shadow\n"));
+    CopyMem (InternalTpmCrb->CrbDataBuffer, TpmCommandBuffer, ResponseSize);
+    return EFI_SUCCESS;
+  }
+
+  Status = TpmSstStartBuffer (mActiveLocality, InternalTpmCrb, TpmCommandBuffer, CommandSize, ResponseSize);
+  if (Status == EFI_SUCCESS) {
+    PcrShadowHandleResponse (TpmCommandBuffer, ResponseSize);
+  }
+
+  return Status;
+}
+
 /**
   Handles commands for the TPM service
 
@@ -266,7 +321,7 @@ HandleCommand (
          * Once the command completes, transition to the COMPLETE state. */
       } else if (InternalTpmCrb->CrbControlStart & PTP_CRB_CONTROL_START) {
         DEBUG ((DEBUG_INFO, "READY State - Handle TPM Command Start Request\n"));
-        Status = TpmSstStart (mActiveLocality, InternalTpmCrb);
+        Status = ExecuteCommand (InternalTpmCrb);
         if (Status == EFI_SUCCESS) {
           mCurrentState = TPM_STATE_COMPLETE;
         }
@@ -308,7 +363,7 @@ HandleCommand (
          * is 1. */
         if (TpmSstIsIdleBypassSupported ()) {
           DEBUG ((DEBUG_INFO, "COMPLETE State - Handle TPM Command Start Request\n"));
-          Status = TpmSstStart (mActiveLocality, InternalTpmCrb);
+          Status = ExecuteCommand (InternalTpmCrb);
         }
       }
 
@@ -672,6 +727,9 @@ TpmServiceInit (
   /* Initialize the TPM Service State Translation Library. */
   TpmSstInit ();
 
+  /* Start with an empty PCR shadow, it is filled by the first PCR reads. */
+  PcrShadowInit ();
+
   /* Initialize our default state information. */
   mCurrentState   = TPM_STATE_IDLE;
   mActiveLocality = NO_ACTIVE_LOCALITY;
@@ -689,6 +747,28 @@ TpmServiceDeInit (
   /* Nothing to DeInit */
 }
 
+/**
+  Retrieves the counters of the PCR shadow
+
+  @param  Statistics  Returns the PCR shadow counters
+
+  @retval EFI_SUCCESS            Statistics holds the counters
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL
+
+**/
+EFI_STATUS
+TpmServiceGetPcrShadowStatistics (
+  TPM_PCR_SHADOW_STATISTICS  *Statistics
+  )
+{
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PcrShadowGetStatistics (Statistics);
+  return EFI_SUCCESS;
+}
+
 /**
   Handler for TPM service commands
 
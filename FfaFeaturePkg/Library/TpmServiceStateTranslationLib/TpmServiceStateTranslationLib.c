@@ -37,6 +37,9 @@
 STATIC BOOLEAN  mIsCrbInterface;
 STATIC BOOLEAN  mIsIdleBypassSupported;
 
+/* Cancel register of the internal CRB for the command in flight, NULL when no command is executing */
+STATIC UINT32  *mCancelRegister;
+
 /* TPM Service State Translation Library Static Functions */
 
 /**
@@ -109,6 +112,29 @@ DumpTpmOutputBlock (
   return;
 } // DumpTpmOutputBlock()
 
+/**
+  Checks whether the client has requested cancellation of the command in flight.
+
+  The internal CRB is shared with the client, which can set the cancel bit while
+  the service yields between polling iterations.
+
+  @retval TRUE   Cancellation was requested
+  @retval FALSE  No command is in flight or no cancellation was requested
+
+**/
+STATIC
+BOOLEAN
+IsCancelRequested (
+  VOID
+  )
+{
+  if (mCancelRegister == NULL) {
+    return FALSE;
+  }
+
+  return (MmioRead32 ((UINTN)mCancelRegister) & PTP_CRB_CONTROL_CANCEL) != 0;
+}
+
 /**
   Returns the BurstCount from the ExternalFifo
 
@@ -117,6 +143,7 @@ DumpTpmOutputBlock (
 
   @retval EFI_SUCCESS  Success
   @retval EFI_TIMEOUT  Timeout
+  @retval EFI_ABORTED  The client cancelled the command
 
 **/
 STATIC
@@ -153,6 +180,10 @@ FifoReadBurstCount (
       return Status;
     }
 
+    if (IsCancelRequested ()) {
+      return EFI_ABORTED;
+    }
+
     DelayAmount += YIELD_AMOUNT;
   }
 
@@ -169,6 +200,7 @@ FifoReadBurstCount (
 
   @retval EFI_SUCCESS  Success
   @retval EFI_TIMEOUT  Timeout
+  @retval EFI_ABORTED  The client cancelled the command
 
 **/
 STATIC
@@ -211,6 +243,10 @@ WaitRegisterBits (
       return Status;
     }
 
+    if (IsCancelRequested ()) {
+      return EFI_ABORTED;
+    }
+
     DelayAmount += YIELD_AMOUNT;
   }
 
@@ -226,6 +262,7 @@ WaitRegisterBits (
 
   @retval EFI_SUCCESS  Success
   @retval EFI_TIMEOUT  Timeout
+  @retval EFI_ABORTED  The client cancelled the command
 
 **/
 STATIC
@@ -289,6 +326,7 @@ CopyCommandData (
 
   @retval EFI_SUCCESS  Success
   @retval EFI_TIMEOUT  Timeout
+  @retval EFI_ABORTED  The client cancelled the command
 
 **/
 STATIC
@@ -337,6 +375,7 @@ StartCommand (
 
   @retval EFI_SUCCESS  Success
   @retval EFI_TIMEOUT  Timeout
+  @retval EFI_ABORTED  The client cancelled the command
 
 **/
 STATIC
@@ -387,6 +426,104 @@ CopyResponseData (
   return Status;
 }
 
+/**
+  Aborts the command in flight and returns the TPM to a state where it can
+  accept the next command.
+
+  A CRB TPM is asked to cancel through its CrbControlCancel register and
+  completes the command, typically with TPM_RC_CANCELED. A FIFO TPM has no
+  cancel register, setting commandReady aborts the command instead and no
+  response is produced. A command that already completed is left alone so
+  its real response is returned.
+
+  @param  Locality  The locality of the command to abort
+  @param  Started   Whether the command was handed to the TPM for execution
+
+  @retval EFI_SUCCESS  The TPM completed the command, a response is available
+  @retval EFI_ABORTED  The command was discarded, no response is available
+  @retval EFI_TIMEOUT  Timeout
+
+**/
+STATIC
+EFI_STATUS
+AbortCommand (
+  UINT8    Locality,
+  BOOLEAN  Started
+  )
+{
+  EFI_STATUS              Status;
+  PTP_CRB_REGISTERS_PTR   ExternalCrb;
+  PTP_FIFO_REGISTERS_PTR  ExternalFifo;
+  UINT8                   FifoStatus;
+
+  /* Determine which TPM structure to access */
+  if (mIsCrbInterface) {
+    ExternalCrb = (PTP_CRB_REGISTERS_PTR)(UINTN)(PcdGet64 (PcdTpmBaseAddress) + (Locality * LOCALITY_OFFSET));
+
+    /* A command that was never started is simply not started. */
+    if (!Started) {
+      return EFI_ABORTED;
+    }
+
+    /* Start clears once the TPM completed the command, its response must be returned. */
+    if ((MmioRead32 ((UINTN)&ExternalCrb->CrbControlStart) & PTP_CRB_CONTROL_START) == 0) {
+      return EFI_SUCCESS;
+    }
+
+    /* Propagate the cancel and wait for the TPM to complete the command. */
+    MmioWrite32 ((UINTN)&ExternalCrb->CrbControlCancel, PTP_CRB_CONTROL_CANCEL);
+    Status = WaitRegisterBits (
+               &ExternalCrb->CrbControlStart,
+               0,
+               PTP_CRB_CONTROL_START,
+               PTP_TIMEOUT_B
+               );
+    MmioWrite32 ((UINTN)&ExternalCrb->CrbControlCancel, 0);
+  } else {
+    ExternalFifo = (PTP_FIFO_REGISTERS_PTR)(UINTN)(PcdGet64 (PcdTpmBaseAddress) + (Locality * LOCALITY_OFFSET));
+
+    /* Response data being available means the command completed, its response must be returned. */
+    FifoStatus = MmioRead8 ((UINTN)&ExternalFifo->Status);
+    if (Started && ((FifoStatus & (PTP_FIFO_STS_VALID | PTP_FIFO_STS_DATA)) == (PTP_FIFO_STS_VALID | PTP_FIFO_STS_DATA))) {
+      return EFI_SUCCESS;
+    }
+
+    /* Setting commandReady while a command is being received or executed aborts it. */
+    MmioWrite8 ((UINTN)&ExternalFifo->Status, PTP_FIFO_STS_READY);
+    Status = WaitRegisterBits (
+               (UINT32 *)&ExternalFifo->Status,
+               PTP_FIFO_STS_READY,
+               0,
+               PTP_TIMEOUT_B
+               );
+    if (Status == EFI_SUCCESS) {
+      Status = EFI_ABORTED;
+    }
+  }
+
+  return Status;
+}
+
+/**
+  Writes a TPM_RC_CANCELED response to the given buffer.
+
+  @param  TpmCommandBuffer  The buffer to write the response to
+
+**/
+STATIC
+VOID
+BuildCancelledResponse (
+  UINT8  *TpmCommandBuffer
+  )
+{
+  TPM2_RESPONSE_HEADER  *Response;
+
+  Response               = (TPM2_RESPONSE_HEADER *)TpmCommandBuffer;
+  Response->tag          = SwapBytes16 (TPM_ST_NO_SESSIONS);
+  Response->paramSize    = SwapBytes32 (sizeof (TPM2_RESPONSE_HEADER));
+  Response->responseCode = SwapBytes32 (TPM_RC_CANCELED);
+}
+
 /* TPM Service State Translation Library Global Functions */
 
 /**
@@ -506,6 +643,11 @@ TpmSstCmdReady (
 /**
   Initiates command execution
 
+  The client may cancel the command by setting the cancel bit in the internal CRB,
+  either together with Start or while the service yields waiting on the TPM. The
+  cancel is propagated to the TPM and the command completes with the response of
+  the TPM, or with TPM_RC_CANCELED if the TPM discarded it.
+
   @param  Locality        The locality of the TPM to initiate the command on
   @param  InternalTpmCrb  The internal CRB to copy command data from
 
@@ -519,10 +661,9 @@ TpmSstStart (
   PTP_CRB_REGISTERS_PTR  InternalTpmCrb
   )
 {
-  EFI_STATUS  Status;
-  UINT8       TpmCommandBuffer[sizeof (InternalTpmCrb->CrbDataBuffer)];
-  UINT32      ResponseDataLen;
-  UINT32      CommandDataLen;
+  UINT8   TpmCommandBuffer[sizeof (InternalTpmCrb->CrbDataBuffer)];
+  UINT32  ResponseDataLen;
+  UINT32  CommandDataLen;
 
   /* Init the local variables. */
   ResponseDataLen = InternalTpmCrb->CrbControlResponseSize;
@@ -532,24 +673,79 @@ TpmSstStart (
   /* Copy the CRB command data to the local buffer. */
   CopyMem (TpmCommandBuffer, InternalTpmCrb->CrbDataBuffer, CommandDataLen);
 
+  return TpmSstStartBuffer (Locality, InternalTpmCrb, TpmCommandBuffer, CommandDataLen, ResponseDataLen);
+}
+
+/**
+  Initiates execution of a command already copied out of the internal CRB
+
+  Behaves as TpmSstStart, but the command is taken from a buffer private to the
+  secure partition so the client cannot change it while it is inspected or sent.
+
+  @param  Locality          The locality of the TPM to initiate the command on
+  @param  InternalTpmCrb    The internal CRB the response is copied to
+  @param  TpmCommandBuffer  The command on input, the response on output, sized as the CRB data buffer
+  @param  CommandDataLen    The size of the command in TpmCommandBuffer
+  @param  ResponseDataLen   The size of the response the client accepts
+
+  @retval EFI_SUCCESS  Success
+  @retval EFI_TIMEOUT  Timeout
+
+**/
+EFI_STATUS
+TpmSstStartBuffer (
+  UINT8                  Locality,
+  PTP_CRB_REGISTERS_PTR  InternalTpmCrb,
+  UINT8                  *TpmCommandBuffer,
+  UINT32                 CommandDataLen,
+  UINT32                 ResponseDataLen
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     Started;
+
   DEBUG_CODE_BEGIN ();
   DumpTpmInputBlock (CommandDataLen, TpmCommandBuffer);
   DEBUG_CODE_END ();
 
+  /* Watch the cancel register of the client while the command is in flight. */
+  mCancelRegister = &InternalTpmCrb->CrbControlCancel;
+  Started         = FALSE;
+
+  /* A cancel set together with Start never reaches the TPM. */
+  if (IsCancelRequested ()) {
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+
   /* Copy the command data. */
   Status = CopyCommandData (Locality, TpmCommandBuffer, CommandDataLen);
   if (EFI_ERROR (Status)) {
-    goto Exit;
+    goto Done;
   }
 
   /* Start command execution. */
-  Status = StartCommand (Locality);
-  if (EFI_ERROR (Status)) {
-    goto Exit;
+  Started = TRUE;
+  Status  = StartCommand (Locality);
+
+Done:
+  /* Stop watching the cancel register, neither the response copy nor the abort sequence may be interrupted. */
+  mCancelRegister = NULL;
+  if (Status == EFI_ABORTED) {
+    DEBUG ((DEBUG_INFO, "TPM Command Cancelled\n"));
+    Status = AbortCommand (Locality, Started);
+  }
+
+  if (Status == EFI_ABORTED) {
+    /* The TPM discarded the command, answer the client with TPM_RC_CANCELED. */
+    SetMem (TpmCommandBuffer, sizeof (InternalTpmCrb->CrbDataBuffer), 0);
+    BuildCancelledResponse (TpmCommandBuffer);
+    Status = EFI_SUCCESS;
+  } else if (!EFI_ERROR (Status)) {
+    /* Copy the response data. */
+    Status = CopyResponseData (Locality, TpmCommandBuffer, ResponseDataLen);
   }
 
-  /* Copy the response data. */
-  Status = CopyResponseData (Locality, TpmCommandBuffer, ResponseDataLen);
   if (EFI_ERROR (Status)) {
     goto Exit;
   }
@@ -8,6 +8,8 @@
 
 #[cfg(target_os = "none")]
 mod baremetal;
+#[cfg(target_os = "none")]
+mod service_table;
 
 #[cfg(not(target_os = "none"))]
 fn main() {
@@ -16,11 +18,16 @@ fn main() {
 
 #[cfg(target_os = "none")]
 fn main() -> ! {
-    use ec_service_lib::MessageHandler;
+    use crate::service_table::service_table;
+    #[cfg(feature = "fw-mgmt")]
+    use ec_service_lib::services::FwMgmt;
+    #[cfg(feature = "notify")]
+    use ec_service_lib::services::Notify;
     #[cfg(feature = "tpm")]
     use ec_service_lib::services::{TpmService, TpmSst};
     #[cfg(not(feature = "tpm"))]
     use ec_service_lib::services::TpmServiceStub;
+    #[cfg(feature = "test-service")]
     use test_service_lib::test_svc::Test;
     use odp_ffa::Function;
 
@@ -28,33 +35,34 @@ fn main() -> ! {
     let version = odp_ffa::Version::new().exec().unwrap();
     log::info!("FFA version: {}.{}", version.major(), version.minor());
 
-    #[cfg(feature = "tpm")]
-    let tpm_service = {
-        // Non-secure CRB region shared between non-secure world and secure world.
-        // Secure CRB region only accessible by the TPM service.
-        let (tpm_internal_crb_address, tpm_external_crb_address): (u64, u64) =
-            (0x40200000, 0x0c000000);
-        log::info!("TPM Internal CRB Address: {:X}", tpm_internal_crb_address);
-        log::info!("TPM External CRB Address: {:X}", tpm_external_crb_address);
-        // Initialize the TPM service with its state-translation backend.
-        let mut svc = TpmService::new(TpmSst::new());
-
-        // SAFETY: Writes to the memory-mapped internal CRB regions and initializes
-        //         the SST layer for the external TPM device.
-        unsafe { svc.init(tpm_internal_crb_address, tpm_external_crb_address) };
-        svc
+    let handler = service_table! {
+        #[cfg(feature = "fw-mgmt")]
+        fw_mgmt: FwMgmt = FwMgmt::new(),
+        #[cfg(feature = "notify")]
+        notify: Notify = Notify::new(),
+        #[cfg(feature = "tpm")]
+        tpm: TpmService<TpmSst> = {
+            // Non-secure CRB region shared between non-secure world and secure world.
+            // Secure CRB region only accessible by the TPM service.
+            let (tpm_internal_crb_address, tpm_external_crb_address): (u64, u64) =
+                (0x40200000, 0x0c000000);
+            log::info!("TPM Internal CRB Address: {:X}", tpm_internal_crb_address);
+            log::info!("TPM External CRB Address: {:X}", tpm_external_crb_address);
+            // Initialize the TPM service with its state-translation backend.
+            let mut svc = TpmService::new(TpmSst::new());
+
+            // SAFETY: Writes to the memory-mapped internal CRB regions and initializes
+            //         the SST layer for the external TPM device.
+            unsafe { svc.init(tpm_internal_crb_address, tpm_external_crb_address) };
+            svc
+        },
+        #[cfg(not(feature = "tpm"))]
+        tpm: TpmServiceStub = TpmServiceStub::new(),
+        #[cfg(feature = "test-service")]
+        test: Test = Test::new(),
     };
 
-    #[cfg(not(feature = "tpm"))]
-    let tpm_service = TpmServiceStub::new();
-
-    MessageHandler::new()
-        .append(ec_service_lib::services::FwMgmt::new())
-        .append(ec_service_lib::services::Notify::new())
-        .append(tpm_service)
-        .append(Test::new())
-        .run_message_loop()
-        .expect("Error in run_message_loop");
+    handler.run_message_loop().expect("Error in run_message_loop");
 
     unreachable!()
 }
@@ -0,0 +1,65 @@
+// This project is dual-licensed under Apache 2.0 and MIT terms.
+// See LICENSE-APACHE and LICENSE-MIT for details.
+
+//! Compile-time service registry for the secure partition.
+//!
+//! The set of services hosted by this partition is fixed at build time by Cargo features. Rather than
+//! growing a `MessageHandler` one `append` call at a time in `main`, the services are declared once in a
+//! `service_table!` invocation. Entries whose `cfg` is false are removed before type checking, so their
+//! code never reaches the image, and every enabled service is registered through a monomorphized handler
+//! chain with no runtime table to walk.
+//!
+//! The table also verifies at compile time that no two enabled services claim the same UUID, which the
+//! runtime handler would otherwise resolve silently by first match.
+
+/// Fails const evaluation if `uuids` contains a duplicate entry.
+pub const fn assert_unique_uuids(uuids: &[u128]) {
+    let mut i = 0;
+    while i < uuids.len() {
+        let mut j = i + 1;
+        while j < uuids.len() {
+            if uuids[i] == uuids[j] {
+                panic!("Two services in the service table share the same UUID");
+            }
+            j += 1;
+        }
+        i += 1;
+    }
+}
+
+/// Builds the partition's `MessageHandler` from a static list of services.
+///
+/// Each entry is `name: Type = constructor`, optionally preceded by attributes such as
+/// `#[cfg(feature = "...")]`. Entries are registered in declaration order.
+///
+/// ```ignore
+/// let handler = service_table! {
+///     #[cfg(feature = "notify")]
+///     notify: Notify = Notify::new(),
+///     test: Test = Test::new(),
+/// };
+/// handler.run_message_loop()
+/// ```
+macro_rules! service_table {
+    ($( $(#[$meta:meta])* $name:ident : $ty:ty = $ctor:expr ),* $(,)?) => {{
+        const _: () = $crate::service_table::assert_unique_uuids(&[
+            $( $(#[$meta])* <$ty as ec_service_lib::Service>::UUID.as_u128(), )*
+        ]);
+
+        $(
+            $(#[$meta])*
+            let $name: $ty = $ctor;
+            $(#[$meta])*
+            log::info!("Registering service {}", <$ty as ec_service_lib::Service>::NAME);
+        )*
+
+        let handler = ec_service_lib::MessageHandler::new();
+        $(
+            $(#[$meta])*
+            let handler = handler.append($name);
+        )*
+        handler
+    }};
+}
+
+pub(crate) use service_table;